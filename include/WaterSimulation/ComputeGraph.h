@@ -0,0 +1,93 @@
+#pragma once
+
+#include <Magnum/GL/Texture.h>
+#include <Magnum/GL/TextureFormat.h>
+#include <Magnum/Magnum.h>
+#include <Magnum/Math/Vector2.h>
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+class GpuProfiler;
+
+// Graphe de passes de calcul, reconstruit à chaque pas : chaque passe déclare les images qu'elle lit et écrit,
+// execute() les lance dans l'ordre d'ajout.
+//  - barrières : une seule ShaderImageAccess, et seulement avant une passe qui lit ou écrit une image écrite depuis
+//    la dernière barrière, ou qui écrit une image lue depuis. Des passes indépendantes s'enchaînent sans barrière.
+//  - textures transitoires : leur contenu ne vit que le temps d'un pas. Deux transitoires de même format et
+//    taille dont les intervalles de passes ne se recouvrent pas partagent la même texture. Les textures du pool
+//    sont gardées d'un pas à l'autre, le pool ne grandit que si un pas en demande plus.
+// Les textures importées (état, terrain...) ne sont jamais partagées.
+// Avec un GpuProfiler, les passes consécutives de même nom sont mesurées comme une seule section.
+class ComputeGraph {
+  public:
+    using Resource = std::size_t;
+
+    enum PassFlag {
+        None = 0,
+        EndsWithBarrier = 1, // la passe fait ses propres barrières, la dernière après son dernier dispatch
+    };
+
+    Resource import(Magnum::GL::Texture2D &texture);
+    Resource transient(Magnum::GL::TextureFormat format, const Magnum::Vector2i &size);
+
+    void addPass(const char *name, std::initializer_list<Resource> reads, std::initializer_list<Resource> writes,
+                 std::function<void()> run, PassFlag flags = None);
+
+    // attribue les textures des transitoires, lance les passes avec leurs barrières puis une barrière finale si une
+    // écriture n'est pas encore visible. Vide ensuite le graphe, les ressources déclarées ne sont plus valides
+    void execute(GpuProfiler *profiler = nullptr);
+
+    // texture d'une ressource, valide dans les passes de execute()
+    Magnum::GL::Texture2D &texture(Resource resource);
+
+    // statistiques du dernier execute()
+    int passCount() const { return m_lastPassCount; }
+    int barrierCount() const { return m_lastBarrierCount; }
+    std::size_t poolBytes() const; // textures transitoires allouées
+
+  private:
+    struct Physical {
+        Magnum::GL::Texture2D *texture;
+        bool written; // depuis la dernière barrière
+        bool read;
+    };
+
+    struct ResourceEntry {
+        Magnum::GL::Texture2D *imported; // nullptr pour une transitoire
+        Magnum::GL::TextureFormat format;
+        Magnum::Vector2i size;
+        int firstPass, lastPass;
+        std::size_t physical;
+    };
+
+    struct Pass {
+        const char *name;
+        std::vector<Resource> reads, writes;
+        std::function<void()> run;
+        PassFlag flags;
+    };
+
+    struct PoolTexture {
+        Magnum::GL::Texture2D texture;
+        Magnum::GL::TextureFormat format;
+        Magnum::Vector2i size;
+        int busyUntil; // dernière passe de la transitoire qui l'occupe, pendant compile()
+    };
+
+    void use(Resource resource);
+    void compile();
+    bool needsBarrier(const Pass &pass) const;
+    void barrier();
+
+    std::vector<ResourceEntry> m_resources;
+    std::vector<Pass> m_passes;
+    std::vector<Physical> m_physical;
+    std::vector<PoolTexture> m_pool;
+
+    int m_lastPassCount = 0;
+    int m_lastBarrierCount = 0;
+    int m_barrierCount = 0;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Magnum/GL/TimeQuery.h>
+#include <Magnum/Magnum.h>
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Temps GPU par section (passes de step(), passes de rendu), mesuré par une paire de requêtes GL_TIMESTAMP.
+// Plutôt que GL_TIME_ELAPSED : les sections peuvent s'imbriquer, et llvmpipe ne compte pas les dispatchs dans
+// TIME_ELAPSED. Les requêtes d'une frame sont relues ringSize frames plus tard par beginFrame(), quand le GPU les a
+// finies : rien ne bloque, une frame dont une requête n'est pas encore prête est abandonnée. Une section ouverte
+// plusieurs fois dans la frame (sous-pas) est additionnée, une section imbriquée compte aussi dans son parent.
+class GpuProfiler {
+  public:
+    static constexpr int ringSize = 4;
+    static constexpr int historySize = 240; // frames gardées par section
+
+    bool enabled = false;
+
+    struct Section {
+        std::string name;
+        std::vector<float> history; // ms par frame, anneau de historySize indexé comme m_resolvedFrames
+        float last = 0.0f, average = 0.0f, max = 0.0f;
+    };
+
+    // à appeler en tête de frame : relit la frame la plus ancienne de l'anneau et la réutilise
+    void beginFrame();
+    void begin(const char *name);
+    void end();
+
+    // begin / end sur une portée, sans effet si profiler est nullptr
+    class Scope {
+      public:
+        Scope(GpuProfiler *profiler, const char *name);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+      private:
+        GpuProfiler *m_profiler;
+    };
+
+    const std::vector<Section> &sections() const { return m_sections; }
+    std::size_t resolvedFrames() const { return m_resolvedFrames; }
+    std::size_t droppedFrames() const { return m_droppedFrames; }
+    void clear();
+
+    // une ligne par frame de l'historique, une colonne de ms par section
+    bool writeCsv(const std::string &path) const;
+
+  private:
+    struct Sample {
+        std::size_t section;
+        Magnum::GL::TimeQuery begin, end;
+        bool closed;
+    };
+    struct Frame {
+        std::vector<Sample> samples; // requêtes gardées d'un passage à l'autre dans l'anneau
+        std::size_t used = 0;
+    };
+
+    std::size_t sectionIndex(const char *name);
+    void resolve(Frame &frame);
+
+    std::array<Frame, ringSize> m_frames;
+    int m_frame = 0;
+    std::vector<std::size_t> m_open; // samples des sections ouvertes dans la frame courante
+
+    std::vector<Section> m_sections;
+    std::size_t m_resolvedFrames = 0;
+    std::size_t m_droppedFrames = 0;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Grille 2D pour le solveur CPU, stockée ligne par ligne avec un halo d'une cellule (ghost cells).
+// Chaque ligne commence sur une frontière de 64 octets (row(j) est aligné), le stride est un multiple d'un bloc de 64 octets.
+// Les indices valides vont de -1 à width() en x et de -1 à height() en y, les ghosts évitent de clamper les voisins.
+// T = float pour les calculs, T = uint16_t pour le stockage réduit fp16 / bf16 (voir PackedGrid).
+template <class T> class BasicPaddedGrid {
+  public:
+    static constexpr std::size_t alignment = 64;               // octets, une ligne de cache / un registre AVX-512
+    static constexpr int lanes = alignment / sizeof(T);        // éléments par bloc aligné
+
+    BasicPaddedGrid() = default;
+    // hugePages : demande des pages de 2 Mo au noyau (Linux, grandes grilles seulement), sinon ignoré
+    BasicPaddedGrid(int width, int height, bool hugePages = false);
+    ~BasicPaddedGrid();
+
+    BasicPaddedGrid(const BasicPaddedGrid &) = delete;
+    BasicPaddedGrid &operator=(const BasicPaddedGrid &) = delete;
+    BasicPaddedGrid(BasicPaddedGrid &&other) noexcept;
+    BasicPaddedGrid &operator=(BasicPaddedGrid &&other) noexcept;
+
+    // échange les buffers sans copie, utilisé pour les doubles buffers
+    void swap(BasicPaddedGrid &other) noexcept;
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    int stride() const { return m_stride; } // en éléments
+    bool usesHugePages() const { return m_mapped; }
+    std::size_t bytes() const { return m_bytes; } // taille de l'allocation, halo et padding compris
+
+    // pointeur sur la cellule (0, j), j dans [-1, height()]
+    T *row(int j) { return m_origin + static_cast<std::ptrdiff_t>(j) * m_stride; }
+    const T *row(int j) const { return m_origin + static_cast<std::ptrdiff_t>(j) * m_stride; }
+
+    T &at(int i, int j) { return row(j)[i]; }
+    T at(int i, int j) const { return row(j)[i]; }
+
+    void fill(T value); // intérieur et ghosts
+
+    // recopie les bords de l'intérieur dans le halo (coins compris), équivalent à clamper les indices
+    void fillGhostsClamp();
+
+  private:
+    void release();
+
+    T *m_data = nullptr;   // début de l'allocation
+    T *m_origin = nullptr; // cellule (0, 0)
+    std::size_t m_bytes = 0;
+    int m_width = 0;
+    int m_height = 0;
+    int m_stride = 0;
+    bool m_mapped = false; // alloué par mmap (huge pages) plutôt que par l'allocateur aligné
+};
+
+extern template class BasicPaddedGrid<float>;
+extern template class BasicPaddedGrid<std::uint16_t>;
+
+using PaddedGrid = BasicPaddedGrid<float>;
+
+// Grille de demi-flottants (bits fp16 ou bf16), convertis en float par les noyaux de ShallowWaterCPUKernels.h
+using PackedGrid = BasicPaddedGrid<std::uint16_t>;
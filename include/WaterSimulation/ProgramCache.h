@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Corrade/Containers/StringView.h>
+#include <Magnum/GL/AbstractShaderProgram.h>
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+
+// Binaires des programmes liés (glGetProgramBinary), un fichier par programme dans directory(), nommé par un hash
+// des sources (defines compris) et du pilote. Au démarrage suivant, load() remplace compilation et édition de liens
+// par un glProgramBinary. Un binaire refusé par le pilote (mise à jour, autre GPU) est simplement recompilé et
+// réécrit. Sans dossier (par défaut), load() échoue toujours et store() ne fait rien.
+class ProgramCache {
+  public:
+    static void setDirectory(std::string directory);
+    static const std::string &directory();
+
+    // FNV-1a 64 bits des sources, dans l'ordre de addSource(), et des chaînes renderer / version du contexte courant
+    static std::uint64_t key(std::initializer_list<Corrade::Containers::StringView> sources);
+
+    // programme lié depuis le cache, false s'il faut le compiler
+    static bool load(Magnum::GL::AbstractShaderProgram &program, std::uint64_t key);
+
+    // à appeler après une édition de liens réussie, le programme doit avoir été lié avec setRetrievableBinary(true)
+    static void store(Magnum::GL::AbstractShaderProgram &program, std::uint64_t key);
+
+  private:
+    static std::string path(std::uint64_t key);
+};
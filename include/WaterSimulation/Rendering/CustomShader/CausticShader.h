@@ -51,9 +51,6 @@ namespace WaterSimulation {
 				Corrade::Utility::Error{} << "causticShader: fragment shader compilation failed:\n";
 			}
 
-			CORRADE_INTERNAL_ASSERT_OUTPUT(vert.compile());
-			CORRADE_INTERNAL_ASSERT_OUTPUT(geom.compile());
-			CORRADE_INTERNAL_ASSERT_OUTPUT(frag.compile());
 
 			attachShaders({vert, geom, frag});
 
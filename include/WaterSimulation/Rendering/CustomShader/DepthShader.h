@@ -35,8 +35,6 @@ namespace WaterSimulation
 			if(!frag.compile()) {
 				Corrade::Utility::Error{} << "depthShader: fragment shader compilation failed:\n" ;
 			}
-			CORRADE_INTERNAL_ASSERT_OUTPUT(vert.compile());
-			CORRADE_INTERNAL_ASSERT_OUTPUT(frag.compile());
 
 			attachShaders({vert, frag});			
             bindAttributeLocation(Magnum::Shaders::GenericGL3D::Position::Location, "position");
@@ -50,9 +50,6 @@ namespace WaterSimulation {
 				Corrade::Utility::Error{} << "godray: fragment shader compilation failed:\n";
 			}
 
-			CORRADE_INTERNAL_ASSERT_OUTPUT(vert.compile());
-			CORRADE_INTERNAL_ASSERT_OUTPUT(geom.compile());
-			CORRADE_INTERNAL_ASSERT_OUTPUT(frag.compile());
 
 			attachShaders({vert, geom, frag});
 
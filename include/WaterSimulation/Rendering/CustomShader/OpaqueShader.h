@@ -37,8 +37,6 @@ namespace WaterSimulation
 			if(!frag.compile()) {
 				Corrade::Utility::Error{} << "DepthDebugShader: fragment shader compilation failed:\n" ;
 			}
-			CORRADE_INTERNAL_ASSERT_OUTPUT(vert.compile());
-			CORRADE_INTERNAL_ASSERT_OUTPUT(frag.compile());
 
 			attachShaders({vert, frag});	
 			
@@ -45,8 +45,6 @@ public:
         if(!frag.compile()) {
             Corrade::Utility::Error{} << "PBRShader: fragment shader compilation failed:\n";
         }
-        CORRADE_INTERNAL_ASSERT_OUTPUT(vert.compile());
-        CORRADE_INTERNAL_ASSERT_OUTPUT(frag.compile());
 
         attachShaders({vert, frag});
 
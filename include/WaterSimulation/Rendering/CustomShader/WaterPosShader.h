@@ -33,8 +33,6 @@ namespace WaterSimulation {
 			if (!frag.compile()) {
 				Corrade::Utility::Error{} << "waterPos: fragment shader compilation failed:\n";
 			}
-			CORRADE_INTERNAL_ASSERT_OUTPUT(vert.compile());
-			CORRADE_INTERNAL_ASSERT_OUTPUT(frag.compile());
 
 			attachShaders({vert, frag});
 			bindAttributeLocation(Magnum::Shaders::GenericGL3D::Position::Location, "position");
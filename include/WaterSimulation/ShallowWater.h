@@ -14,18 +14,30 @@
 #include "Magnum/GL/TextureArray.h"
 #include <Magnum/GL/AbstractShaderProgram.h>
 #include <Magnum/GL/Buffer.h>
+#include <Magnum/GL/Context.h>
 #include <Magnum/GL/Texture.h>
 #include <Magnum/GL/TextureFormat.h>
 #include <Magnum/GL/Version.h>
 #include <Magnum/Image.h>
 #include <Magnum/Magnum.h>
+#include <Magnum/Math/Vector2.h>
+#include <Magnum/Math/Vector4.h>
 #include <Magnum/Trade/ImageData.h>
+#include <WaterSimulation/ComputeGraph.h>
+#include <WaterSimulation/GpuProfiler.h>
+#include <WaterSimulation/ProgramCache.h>
 #include <cstddef>
 #include <cstdint>
+#include <string>
+#include <utility>
 #include <vector>
 
 class ShallowWater {
   public:
+    // Format des textures d'état (h, qx, qy) et des textures RGBA de la décomposition, les shaders calculent en fp32.
+    // Les textures complexes de la FFT restent en RG32F : la FFT directe n'est pas normalisée et dépasse vite 65504.
+    enum class StoragePrecision { Float32, Float16 };
+
     // Tunable simulation parameters (exposed to UI)
     float gravity = 9.81f; // la gravité
     float dryEps = 1e-3f; // valeur de h a partir de laquelle une cellule est
@@ -34,10 +46,17 @@ class ShallowWater {
     
     // Airy waves parameters
     float decompositionD = 0.01f;      // d parameter in decomposition (1/100)
-    int diffusionIterations = 128;      // Number of diffusion iterations
+    int diffusionIterations = 128;      // force du lissage, en pas de diffusion explicite équivalents
+    float decompositionTolerance = 1e-3f; // arrêt des V-cycles quand la correction max (en m) passe sous ce seuil
+    int maxDecompositionCycles = 8;     // V-cycles au plus par décomposition
     float airyHBar = 4.0f;              // h_bar in airy waves dispersion
     float transportGamma = 0.25f;       // gamma damping factor in transport
 
+    // Adaptive timestep (see advanceTime)
+    bool adaptiveTimestep = false;
+    float cflNumber = 0.5f;             // dt = cflNumber * dx / max(|u| + sqrt(g h))
+    int maxSubsteps = 64;               // past this the simulation lags behind instead of stalling the frame
+
   private:
     // Dimensions de la simulation
     int nx, ny;            // nombre de cellules sur chaque axe
@@ -46,34 +65,34 @@ class ShallowWater {
 
     // stabilité
     float limitCFL; // coefficient CFL
+    float maxDt;    // dt donné à la construction, borne du pas adaptatif
 
-    // Compute Shaders
+    // vitesse d'onde max mesurée à la fin du dernier advanceTime, relue au suivant
+    bool m_waveSpeedPending = false;
+    int m_lastSubsteps = 0;
 
-    bool ping = false;
+    // Compute Shaders
 
     Magnum::GL::Texture2D m_stateTexture; // RGB 32f texture that contains (h, qx, qy)
-    Magnum::GL::Texture2D m_stateTexturePong; // ping pong setup // texture final
-    Magnum::GL::Texture2D m_prevStateTexture; // Previous state for height update
+    Magnum::GL::Texture2D m_stateTexturePong; // nouvel état écrit par step(), échangé avec m_stateTexture
     Magnum::GL::Texture2D m_terrainTexture;   // Terrain R 32f texture
 
     //
     Magnum::GL::Texture2D m_bulkTexture; 
-    Magnum::GL::Texture2D m_surfaceTexture; 
 
     Magnum::GL::Texture2D m_surfaceHeightTexture;
     Magnum::GL::Texture2D m_surfaceQxTexture;
     Magnum::GL::Texture2D m_surfaceQyTexture;
 
-    Magnum::GL::Texture2D m_surfaceHeightPing;
-    Magnum::GL::Texture2D m_surfaceHeightPong;
-    Magnum::GL::Texture2D m_surfaceQxPong;
-    Magnum::GL::Texture2D m_surfaceQyPong;
+    // passes de step() : barrières et textures intermédiaires (bulk mis à jour, spectres, surface transportée...),
+    // transitoires partagées entre passes dont les durées de vie ne se recouvrent pas
+    ComputeGraph m_graph;
+    GpuProfiler *m_profiler = nullptr; // sections par nom de passe du graphe, non possédé
 
-    Magnum::GL::Texture2D m_tempTexture;
-    Magnum::GL::Texture2D m_tempTexture2;
-    Magnum::GL::Texture2D m_tempTexture3;
-
-    // Debug textures
+    // Debug textures : copies des étapes de step() pour la fenêtre "Algorithm Visualization", allouées par
+    // requestDebugCapture() et remplies seulement par le step() qui suit une demande
+    bool m_debugTexturesAllocated = false;
+    bool m_captureNextStep = false;
     Magnum::GL::Texture2D m_visBulkUpdated;
     Magnum::GL::Texture2D m_visFFTHeight;
     Magnum::GL::Texture2D m_visFFTQx;
@@ -92,29 +111,97 @@ class ShallowWater {
 
     int groupx, groupy;
 
+    StoragePrecision m_precision = StoragePrecision::Float32;
+
     struct ComputeProgram : public Magnum::GL::AbstractShaderProgram {
 
         ComputeProgram() = default;
 
-        ComputeProgram(Magnum::Containers::String filepath) {
-            Magnum::GL::Shader compute(Magnum::GL::Version::GL430,
-                                       Magnum::GL::Shader::Type::Compute);
+        // format des images d'état, STATE_FORMAT dans les shaders
+        Magnum::GL::ImageFormat stateFormat = Magnum::GL::ImageFormat::RGBA32F;
+
+        // binaire de ProgramCache, sinon compilation et édition de liens soumises sans en attendre le résultat
+        // (threads du pilote avec KHR_parallel_shader_compile) : finishLink() avant le premier dispatch.
+        // activeTiles : variante pour runIndirect() sur la liste de tuiles de activeTiles.comp (activeTiles.glsl)
+        ComputeProgram(Magnum::Containers::String filepath,
+                       StoragePrecision precision = StoragePrecision::Float32, bool activeTiles = false) {
+            const char *formatDefine = "#define STATE_FORMAT rgba32f\n";
+            if (precision == StoragePrecision::Float16) {
+                stateFormat = Magnum::GL::ImageFormat::RGBA16F;
+                formatDefine = "#define STATE_FORMAT rgba16f\n";
+            }
 
             Corrade::Utility::Resource rs{"WaterSimulationResources"};
-            compute.addSource(rs.getString(filepath));
+            const Corrade::Containers::StringView parameters = rs.getString("parameters.glsl");
+            const Corrade::Containers::StringView tiles =
+                activeTiles ? rs.getString("activeTiles.glsl") : Corrade::Containers::StringView{};
+            const Corrade::Containers::StringView source = rs.getString(filepath);
+
+            cacheKey = ProgramCache::key({formatDefine, parameters, tiles, source});
+            if (ProgramCache::load(*this, cacheKey)) {
+                cacheUniformLocations();
+                return;
+            }
 
-            CORRADE_INTERNAL_ASSERT_OUTPUT(compute.compile());
+            compute = Magnum::GL::Shader{Magnum::GL::Version::GL430, Magnum::GL::Shader::Type::Compute};
+            compute.addSource(formatDefine).addSource(parameters).addSource(tiles).addSource(source);
+            compute.submitCompile();
 
             attachShader(compute);
-            link();
+            setRetrievableBinary(!ProgramCache::directory().empty());
+            submitLink();
+            linkPending = true;
+        }
+
+        // attend la compilation soumise par le constructeur, sans effet pour un programme du cache
+        void finishLink() {
+            if (!linkPending)
+                return;
+
+            CORRADE_INTERNAL_ASSERT_OUTPUT(checkLink({compute}));
+            ProgramCache::store(*this, cacheKey);
+            cacheUniformLocations();
+            compute = Magnum::GL::Shader{Magnum::NoCreate};
+            linkPending = false;
+        }
+
+        Magnum::GL::Shader compute{Magnum::NoCreate}; // gardé jusqu'à finishLink() pour le log de compilation
+        std::uint64_t cacheKey = 0;
+        bool linkPending = false;
+
+        // emplacements des uniforms actifs, lus une fois après l'édition de liens : les set*Uniform d'un dispatch ne
+        // repassent plus par glGetUniformLocation. Un nom absent (uniform optimisé) donne -1, ignoré par GL
+        std::vector<std::pair<std::string, Magnum::Int>> uniformLocations;
+
+        void cacheUniformLocations() {
+            GLint count = 0, maxLength = 0;
+            glGetProgramiv(id(), GL_ACTIVE_UNIFORMS, &count);
+            glGetProgramiv(id(), GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+            std::string name(std::size_t(maxLength), '\0');
+            for (GLint i = 0; i < count; ++i) {
+                GLsizei length = 0;
+                GLint size = 0;
+                GLenum type = 0;
+                glGetActiveUniform(id(), GLuint(i), maxLength, &length, &size, &type, &name[0]);
+                const GLint location = glGetUniformLocation(id(), name.c_str());
+                if (location >= 0) // les membres du bloc SimulationParameters n'ont pas d'emplacement
+                    uniformLocations.emplace_back(name.substr(0, std::size_t(length)), location);
+            }
+        }
+
+        Magnum::Int cachedLocation(const char *name) const {
+            for (const auto &uniform : uniformLocations)
+                if (uniform.first == name)
+                    return uniform.second;
+            return -1;
         }
 
         ComputeProgram &bindStates(Magnum::GL::Texture2D *input,
                                    Magnum::GL::Texture2D *output) {
             input->bindImage(0, 0, Magnum::GL::ImageAccess::ReadOnly,
-                             Magnum::GL::ImageFormat::RGBA32F);
+                             stateFormat);
             output->bindImage(1, 0, Magnum::GL::ImageAccess::WriteOnly,
-                              Magnum::GL::ImageFormat::RGBA32F);
+                              stateFormat);
             return *this;
         }
 
@@ -133,11 +220,11 @@ class ShallowWater {
                                    Magnum::GL::Texture2D *tempOut){
 
             stateIn->bindImage(0, 0, Magnum::GL::ImageAccess::ReadOnly,
-                             Magnum::GL::ImageFormat::RGBA32F);
+                             stateFormat);
             terrain->bindImage(1, 0, Magnum::GL::ImageAccess::ReadOnly,
                               Magnum::GL::ImageFormat::R32F);
             bulk->bindImage(2, 0, Magnum::GL::ImageAccess::WriteOnly,
-                             Magnum::GL::ImageFormat::RGBA32F);
+                             stateFormat);
             surfaceHeight->bindImage(3, 0, Magnum::GL::ImageAccess::WriteOnly,
                               Magnum::GL::ImageFormat::RG32F);
             surfaceQx->bindImage(4, 0, Magnum::GL::ImageAccess::WriteOnly,
@@ -147,7 +234,7 @@ class ShallowWater {
             tempIn->bindImage(6, 0, Magnum::GL::ImageAccess::ReadOnly,
                               Magnum::GL::ImageFormat::RGBA32F);
             tempOut->bindImage(7, 0, Magnum::GL::ImageAccess::WriteOnly,
-                              Magnum::GL::ImageFormat::RGBA32F);
+                              stateFormat);
             return *this;
         }
 
@@ -160,16 +247,24 @@ class ShallowWater {
             return *this;
         }
 
-        ComputeProgram &bindReadWrite(Magnum::GL::Texture2D * input, Magnum::GL::ImageFormat format = Magnum::GL::ImageFormat::RGBA32F){
+        ComputeProgram &bindReadWrite(Magnum::GL::Texture2D * input, Magnum::GL::ImageFormat format){
             input->bindImage(0,0,Magnum::GL::ImageAccess::ReadWrite, format);
             return *this;
         }
 
-        ComputeProgram &bindClear(Magnum::GL::Texture2D * output, Magnum::GL::ImageFormat format = Magnum::GL::ImageFormat::RGBA32F){
+        ComputeProgram &bindReadWrite(Magnum::GL::Texture2D * input){
+            return bindReadWrite(input, stateFormat);
+        }
+
+        ComputeProgram &bindClear(Magnum::GL::Texture2D * output, Magnum::GL::ImageFormat format){
             output->bindImage(0,0,Magnum::GL::ImageAccess::WriteOnly, format);
             return *this;
         }
 
+        ComputeProgram &bindClear(Magnum::GL::Texture2D * output){
+            return bindClear(output, stateFormat);
+        }
+
         ComputeProgram &bindCopy(Magnum::GL::Texture2D * input, Magnum::GL::Texture2D * output){
             input->bindImage(0,0,Magnum::GL::ImageAccess::ReadOnly, Magnum::GL::ImageFormat::RG32F);
             output->bindImage(1,0,Magnum::GL::ImageAccess::WriteOnly, Magnum::GL::ImageFormat::RG32F);
@@ -177,8 +272,8 @@ class ShallowWater {
         }
 
         ComputeProgram &bindCopyRGBA(Magnum::GL::Texture2D * input, Magnum::GL::Texture2D * output){
-            input->bindImage(0,0,Magnum::GL::ImageAccess::ReadOnly, Magnum::GL::ImageFormat::RGBA32F);
-            output->bindImage(1,0,Magnum::GL::ImageAccess::WriteOnly, Magnum::GL::ImageFormat::RGBA32F);
+            input->bindImage(0,0,Magnum::GL::ImageAccess::ReadOnly, stateFormat);
+            output->bindImage(1,0,Magnum::GL::ImageAccess::WriteOnly, stateFormat);
             return *this;
         }
 
@@ -187,7 +282,7 @@ class ShallowWater {
                      Magnum::GL::Texture2D *surfaceQxFFT,
                      Magnum::GL::Texture2D *surfaceQyFFT) {
             bulkState->bindImage(0, 0, Magnum::GL::ImageAccess::ReadOnly,
-                     Magnum::GL::ImageFormat::RGBA32F);
+                     stateFormat);
             surfaceHeightFFT->bindImage(1, 0, Magnum::GL::ImageAccess::ReadOnly,
                         Magnum::GL::ImageFormat::RG32F);
             surfaceQxFFT->bindImage(2, 0, Magnum::GL::ImageAccess::ReadWrite,
@@ -203,9 +298,9 @@ class ShallowWater {
                      Magnum::GL::Texture2D *surfaceQx,
                      Magnum::GL::Texture2D *surfaceQy) {
             stateOut->bindImage(0, 0, Magnum::GL::ImageAccess::WriteOnly,
-                     Magnum::GL::ImageFormat::RGBA32F);
+                     stateFormat);
             bulkFlow->bindImage(1, 0, Magnum::GL::ImageAccess::ReadOnly,
-                        Magnum::GL::ImageFormat::RGBA32F);
+                        stateFormat);
             surfaceHeight->bindImage(2, 0, Magnum::GL::ImageAccess::ReadOnly,
                         Magnum::GL::ImageFormat::RG32F);
             surfaceQx->bindImage(3, 0, Magnum::GL::ImageAccess::ReadOnly,
@@ -226,12 +321,12 @@ class ShallowWater {
                      Magnum::GL::ImageFormat::RG32F);
 
             bulkFlow->bindImage(2, 0, Magnum::GL::ImageAccess::ReadOnly,
-                        Magnum::GL::ImageFormat::RGBA32F);
+                        stateFormat);
             bulkFLowOld->bindImage(1, 0, Magnum::GL::ImageAccess::ReadOnly,
-                        Magnum::GL::ImageFormat::RGBA32F);
+                        stateFormat);
 
             surfaceOut->bindImage(0, 0, Magnum::GL::ImageAccess::WriteOnly,
-                        Magnum::GL::ImageFormat::RGBA32F);
+                        stateFormat);
             return *this;
         }
 
@@ -242,10 +337,10 @@ class ShallowWater {
                      Magnum::GL::ImageFormat::RG32F);
 
             bulkFlow->bindImage(1, 0, Magnum::GL::ImageAccess::ReadOnly,
-                        Magnum::GL::ImageFormat::RGBA32F);
+                        stateFormat);
 
             surfaceOut->bindImage(0, 0, Magnum::GL::ImageAccess::ReadWrite,
-                        Magnum::GL::ImageFormat::RGBA32F);
+                        stateFormat);
             return *this;
         }
 
@@ -253,11 +348,11 @@ class ShallowWater {
                           Magnum::GL::Texture2D *surfaceOut,
                           Magnum::GL::Texture2D *bulkFlow) {
             surfaceIn->bindImage(0, 0, Magnum::GL::ImageAccess::ReadOnly,
-                     Magnum::GL::ImageFormat::RGBA32F);
+                     stateFormat);
             surfaceOut->bindImage(1, 0, Magnum::GL::ImageAccess::WriteOnly,
-                      Magnum::GL::ImageFormat::RGBA32F);
+                      stateFormat);
             bulkFlow->bindImage(2, 0, Magnum::GL::ImageAccess::ReadOnly,
-                    Magnum::GL::ImageFormat::RGBA32F);
+                    stateFormat);
             return *this;
         }
 
@@ -266,37 +361,33 @@ class ShallowWater {
                          Magnum::GL::Texture2D *stateIn,
                          Magnum::GL::Texture2D *stateOut) {
             bulk->bindImage(0, 0, Magnum::GL::ImageAccess::ReadOnly,
-                    Magnum::GL::ImageFormat::RGBA32F);
+                    stateFormat);
             surface->bindImage(1, 0, Magnum::GL::ImageAccess::ReadOnly,
-                       Magnum::GL::ImageFormat::RGBA32F);
+                       stateFormat);
             stateIn->bindImage(2, 0, Magnum::GL::ImageAccess::ReadOnly,
-                    Magnum::GL::ImageFormat::RGBA32F);
+                    stateFormat);
             stateOut->bindImage(3, 0, Magnum::GL::ImageAccess::WriteOnly,
-                    Magnum::GL::ImageFormat::RGBA32F);
-            return *this;
-        }
-
-        ComputeProgram &setParametersUniforms(ShallowWater &sim) {
-            setUniform(uniformLocation("dx"), sim.dx);
-            setUniform(uniformLocation("dt"), sim.dt);
-            setUniform(uniformLocation("gravity"), sim.gravity);
-            setUniform(uniformLocation("dryEps"), sim.dryEps);
-            setUniform(uniformLocation("friction_coef"), sim.friction_coef);
+                    stateFormat);
             return *this;
         }
 
         ComputeProgram &setFloatUniform(const char *name, float value) {
-            setUniform(uniformLocation(name), value);
+            setUniform(cachedLocation(name), value);
             return *this;
         }
 
         ComputeProgram &setIntUniform(const char *name, int value) {
-            setUniform(uniformLocation(name), value);
+            setUniform(cachedLocation(name), value);
             return *this;
         }
 
         ComputeProgram &setVec2Uniform(const char *name, Magnum::Vector2 value) {
-            setUniform(uniformLocation(name), value);
+            setUniform(cachedLocation(name), value);
+            return *this;
+        }
+
+        ComputeProgram &setVec2iUniform(const char *name, Magnum::Vector2i value) {
+            setUniform(cachedLocation(name), value);
             return *this;
         }
 
@@ -304,14 +395,44 @@ class ShallowWater {
             dispatchCompute({nx, ny, 1});
             return *this;
         }
+
+        // nombre de groupes lu dans les 12 premiers octets de buffer. Magnum n'a pas de dispatch indirect : l'état
+        // programme / buffer suivi par le contexte est invalidé après les appels GL directs
+        ComputeProgram &runIndirect(Magnum::GL::Buffer &buffer) {
+            glUseProgram(id());
+            glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, buffer.id());
+            glDispatchComputeIndirect(0);
+            Magnum::GL::Context::current().resetState(Magnum::GL::Context::State::Shaders |
+                                                      Magnum::GL::Context::State::Buffers);
+            return *this;
+        }
     };
 
     ComputeProgram m_computeVelocitiesProgram;
     ComputeProgram m_updateFluxesProgram;
     ComputeProgram m_updateWaterHeightProgram;
     ComputeProgram m_updateHeightSimpleProgram;
+    ComputeProgram m_updateFluxesHeightProgram; // les deux précédents fusionnés, chemin sans ondes d'Airy
+
+    // sans ondes d'Airy, seules les tuiles 16 x 16 où il y a de l'eau sont calculées : activeTiles.comp en fait la
+    // liste et le nombre de groupes (m_activeTileBuffer), les variantes *Tiled la parcourent par runIndirect()
+    ComputeProgram m_activeTilesProgram;
+    ComputeProgram m_updateFluxesTiledProgram;
+    ComputeProgram m_updateHeightSimpleTiledProgram;
+    ComputeProgram m_updateFluxesHeightTiledProgram;
+    Magnum::GL::Buffer m_activeTileBuffer; // uvec4 de glDispatchComputeIndirect, puis une tuile par uint
+    Magnum::GL::Buffer m_tileWetBuffer;    // un uint par tuile : état non nul au pas précédent
+    // flux des deux passes séparées sur les tuiles actives : gardés d'un pas à l'autre, la passe hauteur d'une tuile
+    // lit la première colonne / ligne de ses voisines, nulles tant que celles-ci sont inactives
+    Magnum::GL::Texture2D m_tileFluxTexture{Magnum::NoCreate};
+    void runActiveTiles();
+    // chemin du pas précédent (0 : grille complète), toutes les tuiles sont calculées deux pas après un changement
+    // pour que l'état et la texture pong soient écrits partout
+    int m_activeTilesPath = 0;
+    int m_activeTilesWarmup = 0;
 
     ComputeProgram m_decompositionProgram;
+    ComputeProgram m_diffusionMultigridProgram;
 
     ComputeProgram m_fftHorizontalProgram;
     ComputeProgram m_fftVerticalProgram;
@@ -319,13 +440,63 @@ class ShallowWater {
     ComputeProgram m_initProgram;
 
     ComputeProgram m_debugAlphaProgram;
+    // perturbations : disturbance.comp les accumule en virgule fixe dans m_disturbanceDelta (imageAtomicAdd),
+    // disturbanceResolve.comp ajoute la somme à h sur leur rectangle englobant. Deux dispatchs quel que soit le
+    // nombre de perturbations, sans course entre sillages qui se recouvrent
     ComputeProgram m_disturbanceProgram;
+    ComputeProgram m_disturbanceResolveProgram;
+    static constexpr float DisturbanceFixedPoint = 262144.0f; // 2^18 : pas de 4e-6, ±8192 par cellule
 
     // Disturbance buffer
     Magnum::GL::Buffer m_disturbanceBuffer;
+    Magnum::GL::Texture2D m_disturbanceDelta{Magnum::NoCreate}; // R32I, nul entre deux applyDisturbances
+
+    ComputeProgram m_maxWaveSpeedProgram;
+    Magnum::GL::Buffer m_waveSpeedBuffer; // un uint, bits du float de la vitesse max
+
+    ComputeProgram m_totalMassProgram;
+    Magnum::GL::Buffer m_massBuffer; // une somme partielle par groupe
+
+    // bloc uniform SimulationParameters de parameters.glsl, commun à tous les programmes. Que des float : la
+    // disposition std140 est celle de la structure, complétée à un multiple de 16 octets
+    struct Parameters {
+        float dx, dt, gravity, dryEps, friction_coef;
+        float decompositionD, airyHBar, transportGamma;
+        float diffusionIterations, decompositionTolerance;
+        float padding[2];
+    };
+    static constexpr Magnum::UnsignedInt ParametersBinding = 0;
+    Magnum::GL::Buffer m_parameterBuffer;
+    Parameters m_uploadedParameters{}; // dernière version envoyée, pour ne renvoyer le bloc que s'il change
+    bool m_parametersUploaded = false;
+
+    // lissage de la décomposition : multigrille, niveau 0 à la taille de la grille, chaque niveau moitié du précédent
+    struct MultigridLevel {
+        Magnum::Vector2i size;
+        Magnum::GL::Texture2D u;     // solution (erreur sur les niveaux grossiers), tout en RGBA32F
+        Magnum::GL::Texture2D rhs;   // niveaux grossiers seulement, voir multigridRhs
+        Magnum::GL::Texture2D coef;  // (sigma, k gauche, k bas), RGBA32F
+    };
+    // second membre et coefficients du niveau l : ceux du niveau 0 ne servent que pendant la décomposition, ce sont
+    // des transitoires du graphe (m_fineRhs, m_fineCoef, donnés par la passe multigrille)
+    Magnum::GL::Texture2D &multigridRhs(std::size_t l) { return l == 0 ? *m_fineRhs : m_multigrid[l].rhs; }
+    Magnum::GL::Texture2D &multigridCoef(std::size_t l) { return l == 0 ? *m_fineCoef : m_multigrid[l].coef; }
+    Magnum::GL::Texture2D *m_fineRhs = nullptr;
+    Magnum::GL::Texture2D *m_fineCoef = nullptr;
+    std::vector<MultigridLevel> m_multigrid;
+    std::size_t m_multigridDepth = 1;     // niveaux utilisés, d'après diffusionIterations
+    Magnum::GL::Buffer m_multigridBuffer; // correction mesurée, done, cycles (diffusionMultigrid.comp)
+    bool m_multigridWarm = false;         // m_multigrid[0].u contient la solution de la décomposition précédente
 
     ComputeProgram m_fftProgram;
 
+    // FFT réelle en un dispatch par axe pour les trois canaux (fftStockham.comp), tant que Nx/2 et Ny tiennent en
+    // mémoire partagée et ne se décomposent qu'en facteurs 2, 3 et 5
+    ComputeProgram m_fftStockhamProgram;
+    Magnum::GL::Buffer m_twiddleBuffer; // exp(-2 i pi k / Nx), k < Nx, puis exp(-2 i pi k / Ny), k < Ny
+    bool m_stockhamFFT = false;
+    bool m_airySupported = true; // faux si aucune des deux FFT ne s'applique à la grille : step() ignore les ondes d'Airy
+
     ComputeProgram m_bitReverseProgram;
 
     ComputeProgram m_normalizedProgram; // To normalized ifft output
@@ -345,40 +516,78 @@ class ShallowWater {
 
     ComputeProgram m_semiLagrangianAdvectionProgram;
 
+    // sources et puits (createWater.comp) : commandes ponctuelles en file et sources permanentes, appliquées par
+    // flushSources en un dispatch sur les seules tuiles touchées par leurs rectangles
     ComputeProgram m_createWaterProgram;
 
+    enum SourceKind : Magnum::Int { DiscSource = 0, WallSource = 1, InflowSource = 2, DrainSource = 3 };
+
+    struct SourceCommand { // std430 de Source dans createWater.comp
+        Magnum::Vector2 position;
+        float radius;
+        float amount;
+        Magnum::Int kind;
+        Magnum::Int wallSide;
+        float wallWidth;
+        float _padding;
+    };
+
+    struct PersistentSource {
+        int id;
+        Magnum::Vector2 position;
+        float radius;
+        SourceKind kind;
+        std::vector<Magnum::Vector2> hydrograph; // (temps depuis l'ajout, débit en m³/s)
+        int cells;                               // cellules du disque, le volume y est réparti
+        float age = 0.0f;
+    };
+
+    std::vector<SourceCommand> m_pendingSources;
+    std::vector<PersistentSource> m_persistentSources;
+    int m_nextSourceId = 0;
+    Magnum::GL::Buffer m_sourceBuffer;      // SourceCommand
+    Magnum::GL::Buffer m_sourceTileBuffer;  // uvec4 (x, y, première commande, nombre) par tuile touchée
+    Magnum::GL::Buffer m_sourceIndexBuffer; // commandes de chaque tuile, dans l'ordre de la file
+    std::vector<Magnum::Vector4ui> m_sourceTiles;
+    std::vector<Magnum::UnsignedInt> m_sourceIndices;
+
+    int addPersistentSource(SourceKind kind, float x, float y, float radius, std::vector<Magnum::Vector2> hydrograph);
+
   public:
     ShallowWater() = default;
 
     ShallowWater(size_t nx_, size_t ny_, float dx_, float dt_,
-                 int groups = 16) {
+                 int groups = 16,
+                 StoragePrecision precision = StoragePrecision::Float32) {
         nx = nx_;
         ny = ny_;
         dx = dx_;
         dt = dt_;
+        m_precision = precision;
+
+        const Magnum::GL::TextureFormat stateFormat =
+            precision == StoragePrecision::Float16 ? Magnum::GL::TextureFormat::RGBA16F
+                                                   : Magnum::GL::TextureFormat::RGBA32F;
 
-        groupx = (nx + groups - 1) / groups;
-        groupy = (ny + groups - 1) / groups;
+        // (nx + 1) x (ny + 1) texels
+        groupx = (nx + groups) / groups;
+        groupy = (ny + groups) / groups;
 
         limitCFL = dx / (4.0f * dt);
+        maxDt = dt;
 
         //
 
         m_stateTexture
             .setStorage(
-                1, Magnum::GL::TextureFormat::RGBA32F,
+                1, stateFormat,
                 {nx + 1, ny + 1}) // Store only 3 components but there a no
                                   // RGB32F image format for compute binding
             .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
             .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
 
         m_stateTexturePong
-            .setStorage(1, Magnum::GL::TextureFormat::RGBA32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
-
-        m_prevStateTexture
-            .setStorage(1, Magnum::GL::TextureFormat::RGBA32F, {nx + 1, ny + 1})
+            .setStorage(1, stateFormat, {nx + 1, ny + 1})
             .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
             .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
 
@@ -387,11 +596,7 @@ class ShallowWater {
             .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
             .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
 
-        m_bulkTexture.setStorage(1, Magnum::GL::TextureFormat::RGBA32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
-
-        m_surfaceTexture.setStorage(1, Magnum::GL::TextureFormat::RGBA32F, {nx + 1, ny + 1})
+        m_bulkTexture.setStorage(1, stateFormat, {nx + 1, ny + 1})
             .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
             .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
 
@@ -409,94 +614,84 @@ class ShallowWater {
             .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
             .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
 
-        m_surfaceHeightPing.setStorage(1, Magnum::GL::TextureFormat::RG32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setWrapping(Magnum::GL::SamplerWrapping::Repeat);
+        createMultigridLevels();
+        createSpectrum();
 
-        m_surfaceHeightPong.setStorage(1, Magnum::GL::TextureFormat::RG32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setWrapping(Magnum::GL::SamplerWrapping::Repeat);;
-
-        m_surfaceQxPong.setStorage(1, Magnum::GL::TextureFormat::RG32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
-
-        m_surfaceQyPong.setStorage(1, Magnum::GL::TextureFormat::RG32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
-
-        m_tempTexture.setStorage(1, Magnum::GL::TextureFormat::RGBA32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
-
-        m_tempTexture2.setStorage(1, Magnum::GL::TextureFormat::RGBA32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
-
-        m_tempTexture2.setStorage(1, Magnum::GL::TextureFormat::RGBA32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
-
-        m_tempTexture3.setStorage(1, Magnum::GL::TextureFormat::RGBA32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
-
-        m_visBulkUpdated.setStorage(1, Magnum::GL::TextureFormat::RGBA32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
-
-        m_visFFTHeight.setStorage(1, Magnum::GL::TextureFormat::RG32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
-
-        m_visFFTQx.setStorage(1, Magnum::GL::TextureFormat::RG32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
-
-        m_visFFTQy.setStorage(1, Magnum::GL::TextureFormat::RG32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
-
-        m_visIFFTHeight.setStorage(1, Magnum::GL::TextureFormat::RG32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
-
-        m_visIFFTQx.setStorage(1, Magnum::GL::TextureFormat::RG32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
-
-        m_visIFFTQy.setStorage(1, Magnum::GL::TextureFormat::RG32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
-
-        m_visTransportedFlow.setStorage(1, Magnum::GL::TextureFormat::RGBA32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
-
-        m_visTransportedHeight.setStorage(1, Magnum::GL::TextureFormat::RGBA32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
-
-        m_visAdvectedHeight.setStorage(1, Magnum::GL::TextureFormat::RGBA32F, {nx + 1, ny + 1})
-            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
-            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
-        
+        const std::size_t tiles = std::size_t(groupx) * std::size_t(groupy);
+        m_activeTileBuffer.setData({nullptr, 4 * sizeof(Magnum::UnsignedInt) + tiles * sizeof(Magnum::UnsignedInt)},
+                                   Magnum::GL::BufferUsage::DynamicDraw);
+        m_tileWetBuffer.setData({nullptr, tiles * sizeof(Magnum::UnsignedInt)}, Magnum::GL::BufferUsage::DynamicDraw);
 
         compilePrograms();
     }
 
     void step();
 
+    // Pas de temps adaptatif : max(|u| + sqrt(g h)) est réduit sur le GPU, dt = cflNumber * dx / vitesse (borné
+    // par le dt de construction) et advanceTime enchaîne des sous-pas égaux pour couvrir simulatedTime.
+    // La réduction est lancée à la fin d'un advanceTime et relue au suivant, la lecture ne bloque donc
+    // pas sur le travail de la frame en cours. Sans pas adaptatif : round(simulatedTime / dt) pas.
+    int advanceTime(float simulatedTime);
+    void dispatchMaxWaveSpeed();
+    float readMaxWaveSpeed(); // bloque jusqu'à la fin de la réduction
+    float enforceCFL();       // plus grand dt stable d'après la dernière réduction
+    void setTimestep(float dt_);
+    float getdt() const { return dt; }
+    float getMaxDt() const { return maxDt; }
+    int getLastSubsteps() const { return m_lastSubsteps; }
+
+    StoragePrecision getStoragePrecision() const { return m_precision; }
+    Magnum::GL::ImageFormat stateImageFormat() const {
+        return m_precision == StoragePrecision::Float16 ? Magnum::GL::ImageFormat::RGBA16F
+                                                        : Magnum::GL::ImageFormat::RGBA32F;
+    }
+    Magnum::GL::TextureFormat stateTextureFormat() const {
+        return m_precision == StoragePrecision::Float16 ? Magnum::GL::TextureFormat::RGBA16F
+                                                        : Magnum::GL::TextureFormat::RGBA32F;
+    }
+
+    // volume d'eau (somme des h * dx²) : une somme partielle par groupe sur le GPU, additionnées en double ici.
+    // Bloque jusqu'au résultat, sert à vérifier la dérive de masse du stockage réduit.
+    double totalVolume();
+
+    // octets des textures (pool du graphe compris) et des buffers du solveur
+    std::size_t memoryUsage();
+    // niveau 0 d'une texture stockée en format, ou taille d'un buffer, 0 s'ils n'existent pas
+    static std::size_t textureBytes(Magnum::GL::Texture2D &texture, Magnum::PixelFormat format);
+    static std::size_t textureBytes(Magnum::GL::Texture2DArray &texture, Magnum::PixelFormat format);
+    static std::size_t bufferBytes(Magnum::GL::Buffer &buffer);
+
     void compilePrograms();
+    // remplit le bloc SimulationParameters (parameters.glsl) et le lie ; ne le renvoie au GPU que si une valeur a
+    // changé. Appelé en tête de step() et des fonctions qui lancent des dispatchs hors de step()
+    void uploadParameters();
     
     void clearAllTextures();
 
+    // passes du graphe de step() : chaque dispatch déclare ses images, les barrières sont celles du graphe
     void runSW(Magnum::GL::Texture2D *inputTex,Magnum::GL::Texture2D *outputTex);
-    void runDecomposition(Magnum::GL::Texture2D *inputTex);
-    Magnum::GL::Texture2D* runFFT(Magnum::GL::Texture2D* pingTex, Magnum::GL::Texture2D* pongTex, 
-                        int direction);
+    // input -> m_bulkTexture et m_surface{Height,Qx,Qy}Texture : stage 0, multigrille, stage 2
+    void addDecompositionPasses(ComputeGraph::Resource input);
+    // lissage de la sortie de stage 0 (source), V-cycles compris. Se termine par une barrière
+    void runMultigrid(Magnum::GL::Texture2D *source, Magnum::GL::Texture2D *fineRhs, Magnum::GL::Texture2D *fineCoef);
+    // V-cycles de la dernière décomposition et correction mesurée au dernier. Bloque jusqu'au résultat (UI, bench)
+    int readDecompositionCycles(float &correction);
+    void createMultigridLevels();
+    void runMultigridStage(int stage, Magnum::Vector2i size);
+    void runVCycle(std::size_t l);
+    // FFT multi-passes (bit reversal et étages radix 2) de chaque canal (texture, pong), le résultat revient dans la
+    // texture. Les canaux avancent d'un étage à la fois : une barrière par étage pour tous
+    void addFFTPasses(int direction, std::initializer_list<std::pair<ComputeGraph::Resource, ComputeGraph::Resource>> channels);
+    void runFFTStage(int stage, Magnum::GL::Texture2D *input, Magnum::GL::Texture2D *output, int direction);
+    // directe : m_surface{Height,Qx,Qy}Texture -> demi-spectres ; inverse : spectres de qx, qy -> textures (celui de
+    // h n'est pas modifié par les ondes d'Airy). norm appliqué à la sortie. Deux passes, si m_stockhamFFT
+    void addStockhamFFTPasses(int direction, float norm, ComputeGraph::Resource spectrumQx,
+                              ComputeGraph::Resource spectrumQy, ComputeGraph::Resource spectrumHeight);
+    void runStockhamPass(int pass, int direction, float norm, Magnum::GL::Texture2D *spectrumQx,
+                         Magnum::GL::Texture2D *spectrumQy, Magnum::GL::Texture2D *spectrumHeight);
+    void createSpectrum(); // twiddles de fftStockham.comp, ou vérifie que la FFT multi-passes s'applique
+    void createDebugTextures();
+    void clearDebugTextures();
     void runIFFT();
 
     // helper functions
@@ -510,11 +705,15 @@ class ShallowWater {
     Magnum::GL::Texture2D &getTerrainTexture() { return m_terrainTexture; }
 
     Magnum::GL::Texture2D &getBulkTexture() { return m_bulkTexture; }
-    Magnum::GL::Texture2D &getSurfaceTexture() { return m_surfaceTexture; }
     Magnum::GL::Texture2D &getSurfaceHeightTexture() { return m_surfaceHeightTexture; }
     Magnum::GL::Texture2D &getSurfaceQxTexture() { return m_surfaceQxTexture; }
     Magnum::GL::Texture2D &getSurfaceQyTexture() { return m_surfaceQyTexture; }
 
+    // capture des textures intermédiaires par le prochain step() avec ondes d'Airy, allouées au premier appel.
+    // Sans demande, step() ne fait aucune copie
+    void requestDebugCapture();
+    bool hasDebugTextures() const { return m_debugTexturesAllocated; }
+
     Magnum::GL::Texture2D &getVisBulkUpdated() { return m_visBulkUpdated; }
     Magnum::GL::Texture2D &getVisFFTHeight() { return m_visFFTHeight; }
     Magnum::GL::Texture2D &getVisFFTQx() { return m_visFFTQx; }
@@ -528,19 +727,43 @@ class ShallowWater {
 
     Magnum::GL::Texture2D *getFFTOutput() { return m_fftOutput; }
     Magnum::GL::Texture2D *getIFFTOutput() { return m_ifftOutput; }
+
+    const ComputeGraph &computeGraph() const { return m_graph; } // passes et barrières du dernier pas
+    void setProfiler(GpuProfiler *profiler) { m_profiler = profiler; }
     
 
     bool airyWavesEnabled = true;
+    bool airyWavesSupported() const { return m_airySupported; } // une FFT s'applique à la grille (createSpectrum)
+    // sans ondes d'Airy : flux et hauteur en un seul dispatch (mémoire partagée), sinon les deux passes séparées.
+    // Plus lent sur un rasteriseur logiciel (llvmpipe) où les barrier() coûtent cher
+    bool fusedStepEnabled = true;
+    // sans ondes d'Airy : dispatch indirect sur les seules tuiles mouillées (et leurs voisines à deux cellules près)
+    bool activeTilesEnabled = true;
+    // tuiles 16 x 16 calculées par le dernier pas, -1 s'il a couvert toute la grille. 0 : état nul partout, pong
+    // compris. Bloque jusqu'à la fin du pas
+    int lastActiveTileCount();
     // initialisation
     void initBump();
     void initDamBreak();
     void initTsunami();
     void initEmpty();
 
-    void createWater(float x, float y, float radius, float quantity);
+    // sources et puits, en cellules. createWater et sendWaveWall sont mis en file et appliqués une fois au début
+    // du step() suivant, ou au flushSources(0) de l'application quand la simulation est en pause
+    void createWater(float x, float y, float radius, float quantity); // cône de hauteur quantity
 
     void sendWaveWall(int side, float width, float quantity);
 
+    // sources permanentes, appliquées à chaque pas jusqu'à removeSource(id). Arrivée d'eau : hydrogramme (temps
+    // depuis l'ajout en s, débit en m³/s) interpolé linéairement, dernier débit gardé ensuite. Puits : retire
+    // jusqu'à rate m³/s, sans rendre h négatif
+    int addInflow(float x, float y, float radius, std::vector<Magnum::Vector2> hydrograph);
+    int addDrain(float x, float y, float radius, float rate);
+    void removeSource(int id);
+
+    // commandes en file et sources permanentes sur elapsed secondes, en un dispatch
+    void flushSources(float elapsed);
+
     void loadTerrainHeightMap(Magnum::Trade::ImageData2D *tex,
                               float scaling = 1.0f, int channels = 1);
 
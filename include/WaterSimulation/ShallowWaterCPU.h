@@ -1,14 +1,27 @@
 #pragma once
 
+#include <WaterSimulation/PaddedGrid.h>
+#include <WaterSimulation/ShallowWaterCPUKernels.h>
+#include <WaterSimulation/TextureUploader.h>
+#include <WaterSimulation/ThreadPool.h>
+
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <vector>
 #include <Magnum/Magnum.h>
 #include <Magnum/Image.h>
 #include <Magnum/Trade/ImageData.h>
 #include <Magnum/GL/Texture.h>
 
-class ShallowWater{
+// Solveur shallow water sur CPU, indépendant du GPU. Les étapes sont découpées en bandes de lignes
+// exécutées sur un pool de threads persistant, chaque ligne passe par les noyaux SIMD de ShallowWaterCPUKernels.h.
+// Le résultat est identique au bit près à la version scalaire mono-thread.
+class ShallowWaterCPU{
+public:
+    //format de stockage de h, qx et qy, les calculs restent en float (voir setStoragePrecision)
+    enum class StoragePrecision { Float32, Float16, BFloat16 };
+
 private:
     //Dimensions de la simulation
     int nx, ny; //nombre de cellules sur chaque axe
@@ -16,25 +29,88 @@ private:
     float dt; //le pas de temps
     float gravity = 9.81f; //la gravité
 
-    //Textures des quantités
+    //Textures des quantités, grilles alignées avec un halo d'une cellule (voir PaddedGrid.h)
     //h calculé a t + dt/2, stocké au centre des cellules
-    std::vector<float> h; //calculé a partir de la divergence des q, représente la hauteur de l'eau uniquement (hauteur total = h + terrain)
+    PaddedGrid h; //calculé a partir de la divergence des q, représente la hauteur de l'eau uniquement (hauteur total = h + terrain)
 
-    //q calculé a t + dt, stockés sur les parois des cellules !
-    std::vector<float> qx; //q = h * u
-    std::vector<float> qy;
-    std::vector<float> terrain; // la hauteur du terrain
+    //q calculé a t + dt, stockés sur les parois des cellules ! qx : (nx+1) x ny, qy : nx x (ny+1)
+    PaddedGrid qx; //q = h * u
+    PaddedGrid qy;
+    PaddedGrid qxNext; //doubles buffers de updateFluxes, échangés avec qx / qy à chaque pas
+    PaddedGrid qyNext;
+    PaddedGrid terrain; // la hauteur du terrain
 
     //secondaire, temporaire
-    std::vector<float> ux; //velocité sur l'axe x calculé a partir de qx
-    std::vector<float> uy; //velocité sur l'axe y
+    PaddedGrid ux; //velocité sur l'axe x calculé a partir de qx
+    PaddedGrid uy; //velocité sur l'axe y
 
 
     //stabilité
     float dryEps = 1e-3f; //valeur de h a partir de laquelle une cellule est considéré comme sec
     float limitCFL; //coefficient CFL
+
+    //pas de temps adaptatif (voir advanceTime)
+    bool adaptiveTimestep = false;
+    float cflNumber = 0.5f; //dt = cflNumber * dx / max(|u| + sqrt(g h))
+    float maxDt; //dt donné à la construction, jamais dépassé
+    int maxSubsteps = 64; //au delà, la simulation prend du retard plutôt que de bloquer la frame
     float friction_coef = 0.2f; 
 
+    std::unique_ptr<ThreadPool> pool; //threads de calcul, nullptr = mono-thread
+    void parallelRows(int begin, int end, const std::function<void(int, int)> &fn); //exécute fn sur des bandes de lignes [begin, end)
+    //tranche de bandFloats floats de la bande de parallelRows(begin, end) qui commence en j0, dans bandScratch
+    //(à dimensionner avec reserveBandScratch avant le parallelRows)
+    float *bandScratchSlice(int begin, int end, int j0, std::size_t bandFloats);
+    void reserveBandScratch(std::size_t bandFloats);
+    std::vector<float> bandScratch; //lignes décodées des textures en stockage réduit, ne fait que grandir
+
+    //mode tuilé : plusieurs pas fusionnés par tuile (voir ShallowWaterCPUTiled.cpp)
+    struct TileScratch {
+        PaddedGrid h, terrain, qx, qy, qxNext, qyNext; //copie locale d'une tuile + son halo
+    };
+    int stepsPerSweep = 0; //0 = pas de tuilage, step() fait les passes globales
+    int tileWidth = 256;
+    int tileHeight = 64;
+    bool hugePages = false;
+    PaddedGrid hNext; //h après un balayage, échangé avec h
+    std::vector<TileScratch> tileScratch; //un par bande de threads
+    void sweepTiles(int stepCount);
+    void advanceTile(TileScratch &scratch, int ax, int bx, int ay, int by, int stepCount);
+
+    //tuiles actives : seules les tuiles mouillées et leurs voisines sont calculées (voir ShallowWaterCPUActiveTiles.cpp)
+    bool activeTilesEnabled = false;
+    bool activeTilesDirty = true; //h modifié de l'extérieur, il faut tout rescanner
+    int activeTileSize = 32;
+    int activeTilesX = 0, activeTilesY = 0;
+    std::vector<uint8_t> tileWet; //une cellule de la tuile a h > dryEps
+    std::vector<uint8_t> tileActive;
+    std::vector<int> activeTiles; //indices des tuiles actives, dans l'ordre
+    void stepActiveTiles();
+    void updateActiveTiles(bool rescan);
+    void clearTile(int tile); //met à 0 les flux et vitesses d'une tuile qui devient inactive
+
+    //stockage réduit (voir ShallowWaterCPUPacked.cpp) : l'état vit dans les grilles 16 bits, h / qx / qy ne sont
+    //qu'une copie float décodée à la demande (accesseurs, init, textures) et libérée au pas suivant
+    StoragePrecision storagePrecision = StoragePrecision::Float32;
+    PackedGrid hPacked, qxPacked, qyPacked;
+    PackedGrid hPackedNext, qxPackedNext, qyPackedNext; //sorties des balayages tuilés
+    bool floatStateValid = true; //h, qx, qy contiennent l'état courant
+    bool floatStateModified = false; //la copie float a été modifiée, à réencoder
+    bool isPacked() const { return storagePrecision != StoragePrecision::Float32; }
+    void unpackState(); //décode l'état dans h, qx, qy (no-op en Float32)
+    void packState(); //réencode la copie float si besoin et la libère
+    void packRow(const float *src, std::uint16_t *dst, int n) const;
+    void unpackRow(const std::uint16_t *src, float *dst, int n) const;
+    //lignes j de h, qx et j, j+1 de qy, décodées dans buffer (4 * (nx + 1) floats) si l'état est stocké en 16 bits
+    void stateRows(int j, float *buffer, const float *(&rows)[4]) const;
+
+    //visualisation : anneaux de pixel buffers réutilisés d'une frame à l'autre, l'envoi recouvre le pas suivant
+    TextureUploader heightUploader;
+    TextureUploader momentumUploader;
+
+    const ShallowWaterKernels::Table *kernels = &ShallowWaterKernels::table(); //noyaux par ligne, choisis selon le processeur
+    ShallowWaterKernels::Params kernelParams() const;
+
     //coeur de la simu
     void computeVelocities(); //calcul de u et v a partir de q et h
     void computeVelocitiesDelta(); // calcul des du/dt
@@ -43,41 +119,98 @@ private:
 
     void applyBarrier(); //gère les quantités en bordure
 
-    inline bool isDry(int i, int j){ return h[idc(i, j)] <= dryEps;}
-
-    void enforceCFL(); //Pour garder la simulation stable il ne faut pas que la velocité (ou le pas de temps) soit trop grande
+    inline bool isDry(int i, int j) const { return h.at(i, j) <= dryEps;}
 
-    //helper func
-    float upwinded_h_x(int i, int j,float qxij); // récupère la hauteur sur les faces
-    float upwinded_h_y(int i, int j,float qyij);
 
 public:
 
-    ShallowWater() = default;
+    ShallowWaterCPU() = default;
 
-    ShallowWater(size_t nx_, size_t ny_, float dx_, float dt_){
+    //threads = 0 : un thread par coeur, threads = 1 : mono-thread
+    //hugePages : grilles en pages de 2 Mo quand le système le permet (grandes simulations)
+    ShallowWaterCPU(size_t nx_, size_t ny_, float dx_, float dt_, unsigned threads = 0, bool hugePages = false){
         nx = nx_; ny = ny_; dx = dx_; dt = dt_;
+        this->hugePages = hugePages;
 
-        h.assign( nx * ny, 0.0f);
-        terrain.assign(nx*ny, 0.0f);
-        
-        qx.assign((nx+1) * ny, 0.0f);
-        qy.assign(nx*(ny+1), 0.0f);
+        h = PaddedGrid(nx, ny, hugePages);
+        terrain = PaddedGrid(nx, ny, hugePages);
+
+        qx = PaddedGrid(nx + 1, ny, hugePages);
+        qy = PaddedGrid(nx, ny + 1, hugePages);
+        qxNext = PaddedGrid(nx + 1, ny, hugePages);
+        qyNext = PaddedGrid(nx, ny + 1, hugePages);
 
-        ux.assign((nx+1) * ny, 0.0f);
-        uy.assign(nx*(ny+1), 0.0f);
+        ux = PaddedGrid(nx + 1, ny, hugePages);
+        uy = PaddedGrid(nx, ny + 1, hugePages);
         
         limitCFL = dx / (5.0f*dt);
+        maxDt = dt;
+
+        setThreadCount(threads);
     }
 
     void step();
+    void advance(int stepCount); //équivalent à stepCount appels à step(), par balayages tuilés si setTiling est actif
+
+    //stepsPerSweep > 0 : chaque balayage avance stepsPerSweep pas tuile par tuile (tuiles tileWidth x tileHeight
+    //avec un halo de stepsPerSweep cellules recalculé par chaque tuile), au lieu de 4 passes sur toute la grille par pas.
+    //Les tailles par défaut tiennent dans ~512 Ko de L2. stepsPerSweep = 0 désactive le tuilage.
+    void setTiling(int stepsPerSweep, int tileWidth = 256, int tileHeight = 64);
+
+    //step() ne calcule que les tuiles tileSize x tileSize mouillées et leurs 8 voisines, la liste est mise à jour
+    //à chaque pas. Les tuiles sèches ont des flux nuls, le résultat ne change pas. Ignoré par les balayages tuilés.
+    void setActiveTiles(bool enabled, int tileSize = 32);
+    int activeTileCount() const { return activeTilesEnabled ? static_cast<int>(activeTiles.size()) : activeTilesX * activeTilesY; }
+    int tileCount() const { return activeTilesX * activeTilesY; }
+
+    void setThreadCount(unsigned threads);
+    unsigned threadCount() const { return pool ? pool->size() : 1; }
+
+    //force un jeu d'instructions (Scalar pour comparer), Best par défaut
+    void setKernelIsa(ShallowWaterKernels::Isa isa);
+
+    //Pour garder la simulation stable il ne faut pas que la velocité (ou le pas de temps) soit trop grande
+    float maxWaveSpeed(); //max de |u| + sqrt(g h) sur les cellules mouillées, réduction parallèle
+    float enforceCFL(); //plus grand dt stable, borné par le dt de construction
+
+    void setTimestep(float dt_); //met aussi à jour limitCFL
+    float getdt() const { return dt; }
+
+    //enabled : advanceTime découpe le temps simulé en sous-pas de dt = enforceCFL()
+    //maxTimestep > 0 remplace la borne (dt de construction par défaut), une scène calme peut alors faire de plus grands pas
+    void setAdaptiveTimestep(bool enabled, float cfl = 0.5f, float maxTimestep = 0.0f);
+    bool isAdaptiveTimestep() const { return adaptiveTimestep; }
+    //avance de simulatedTime secondes, retourne le nombre de pas effectués.
+    //Sans pas adaptatif : round(simulatedTime / dt) pas de dt fixe.
+    int advanceTime(float simulatedTime);
+    const char *kernelName() const { return kernels->name; }
+    std::size_t memoryUsage() const; //octets alloués par les grilles et les tuiles
+
+    //Float16 / BFloat16 : h, qx et qy stockés sur 16 bits (conversions F16C / AVX-512 dans les noyaux), calculs en float.
+    //Passe par les balayages tuilés (activés avec 4 pas par balayage si besoin), les tuiles décodent leur zone, avancent
+    //en float et réencodent leur intérieur : l'arrondi n'a lieu qu'une fois par balayage. Les vitesses ux / uy ne sont
+    //calculées que pour updateMomentumTexture. L'état courant est converti au changement de format.
+    void setStoragePrecision(StoragePrecision precision);
+    StoragePrecision getStoragePrecision() const { return storagePrecision; }
+    double totalVolume(); //somme des h, en double, pour suivre la dérive de masse due à l'arrondi
 
 
     //helper functions
 
-    inline int idc(int i, int j) const {return j * nx + i;} //retourne l'index pour les grilles centrés (comme la hauteur)
-    inline int idsx(int i, int j) const { return j * (nx+1) + i;} //index side x, retourne l'index pour les valeurs de qx et ux
-    inline int idsy(int i, int j) const { return j * nx + i;} //index side y, retourne l'index pour les valeurs de qy et uy
+    //accès aux grilles : h.at(i, j) au centre des cellules, qx.at(i, j) / qy.at(i, j) sur les faces
+    //en stockage réduit, l'état est d'abord décodé dans une copie float
+    const PaddedGrid &height() { unpackState(); return h; }
+    const PaddedGrid &terrainHeight() const { return terrain; }
+    const PaddedGrid &momentumX() { unpackState(); return qx; }
+    const PaddedGrid &momentumY() { unpackState(); return qy; }
+    PaddedGrid &waterHeight() { //pour initialiser h, les ghosts sont remis à jour au début de step()
+        unpackState();
+        floatStateModified = true;
+        activeTilesDirty = true;
+        return h;
+    }
+    PaddedGrid &terrainHeight() { return terrain; }
+
     bool isWetFaceX(int i,int j) const;
     bool isWetFaceY(int i,int j) const;
 
@@ -0,0 +1,399 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Noyaux de calcul du solveur CPU, appliqués sur un intervalle [i0, i1) d'une ligne.
+// Chaque noyau existe en version scalaire et en versions SIMD (SSE2 / AVX2 / AVX-512) choisies à l'exécution.
+// Les versions SIMD évaluent les tests sec/mouillé et l'upwinding par des masques, avec exactement les mêmes
+// opérations flottantes que la version scalaire : le résultat est identique au bit près.
+namespace ShallowWaterKernels {
+
+struct Params {
+    float dx;
+    float dt;
+    float gravity;
+    float dryEps;
+    float friction_coef;
+    float limitCFL;
+};
+
+// Face x numéro i d'une ligne : cellules h[i-1] (gauche) et h[i] (droite), flux qx[i-1], qx[i], qx[i+1]
+using FluxXFn = void (*)(const Params &p, const float *h, const float *terrain, const float *qx,
+                         float *qxNew, int i0, int i1);
+
+// Face y d'une ligne j : cellules hB = ligne j-1, hT = ligne j, flux qyB = ligne j-1, qyC = ligne j, qyT = ligne j+1
+using FluxYFn = void (*)(const Params &p, const float *hB, const float *terrainB, const float *hT,
+                         const float *terrainT, const float *qyB, const float *qyC, const float *qyT,
+                         float *qyNew, int i0, int i1);
+
+// Cellule i d'une ligne : divergence de qx[i], qx[i+1] et de qyB[i] (face du bas), qyT[i] (face du haut)
+using HeightFn = void (*)(const Params &p, float *h, const float *qx, const float *qyB, const float *qyT,
+                          int i0, int i1);
+
+// Vitesse sur les faces : u = q / h_upwind, 0 si la face est sèche. Cellules (hA, terrainA) avant la face, (hB, terrainB) après
+using VelocityFn = void (*)(const Params &p, const float *hA, const float *terrainA, const float *hB,
+                            const float *terrainB, const float *q, float *u, int i0, int i1);
+
+// Ensemble (ShallowWaterEnsembleCPU) : les K membres sont entrelacés, le membre m de la cellule i est à l'indice
+// i * K + m et ses voisins à ± K. Les noyaux d'ensemble traitent n valeurs consécutives à partir d'une cellule, la
+// valeur f appartient donc au membre f % K. Les paramètres propres aux membres sont répétés sur period = ppcm(K, 16)
+// lanes : la valeur f lit la lane f % period, un registre SIMD charge ses paramètres d'un bloc.
+struct EnsembleParams {
+    int members;
+    int period;
+    const float *dryEps; // period valeurs chacun
+    const float *gravity;
+    const float *friction_coef;
+};
+
+// qNew[f] = flux de la face entre (hA[f], terrainA[f]) et (hB[f], terrainB[f]), flux voisins qPrev[f] et qNext[f].
+// dx, dt et limitCFL viennent de p, communs à tous les membres
+using EnsembleFluxFn = void (*)(const Params &p, const EnsembleParams &e, const float *hA, const float *terrainA,
+                                const float *hB, const float *terrainB, const float *qPrev, const float *q,
+                                const float *qNext, float *qNew, int n);
+
+// h[f] moins la divergence des flux qL[f], qR[f] (faces x) et qB[f], qT[f] (faces y)
+using EnsembleHeightFn = void (*)(const Params &p, float *h, const float *qL, const float *qR, const float *qB,
+                                  const float *qT, int n);
+
+// Conversions du stockage réduit (PackedGrid) : n valeurs consécutives, arrondi au plus proche pair
+using PackFn = void (*)(const float *src, std::uint16_t *dst, int n);
+using UnpackFn = void (*)(const std::uint16_t *src, float *dst, int n);
+
+enum class Isa { Scalar, SSE2, AVX2, AVX512, Best };
+
+struct Table {
+    const char *name;
+    FluxXFn fluxX;
+    FluxYFn fluxY;
+    HeightFn height;
+    VelocityFn velocity;
+    PackFn packHalf;
+    UnpackFn unpackHalf;
+    PackFn packBFloat16;
+    UnpackFn unpackBFloat16;
+    EnsembleFluxFn ensembleFlux;
+    EnsembleHeightFn ensembleHeight;
+};
+
+// Best = la meilleure version supportée par le processeur. Une Isa non supportée retombe sur la meilleure disponible en dessous.
+const Table &table(Isa isa = Isa::Best);
+
+const Table &scalarTable();
+#if defined(WATERSIM_CPU_X86)
+const Table &sse2Table();
+const Table &avx2Table();
+const Table &avx512Table();
+#endif
+
+// Versions scalaires d'une face / cellule, utilisées par la table scalaire et pour les fins de ligne des noyaux SIMD.
+// Les std::max(a, b) sont écrits b < a ? a : b pour correspondre aux instructions max des SIMD.
+// static : ce header est inclus par des fichiers compilés avec -mavx2 / -mavx512f, il ne faut pas que l'éditeur
+// de liens choisisse une de ces copies pour tout le programme.
+
+static inline float upwindedHeight(const Params &p, float etaA, float etaB, float terrainMax, float q) {
+    float hA = 0.0f < etaA - terrainMax ? etaA - terrainMax : 0.0f;
+    float hB = 0.0f < etaB - terrainMax ? etaB - terrainMax : 0.0f;
+
+    //allow better flooding
+    if (std::abs(q) < p.dryEps)
+        return hA < hB ? hB : hA;
+
+    return (q >= 0.0f) ? hA : hB;
+}
+
+static inline float faceFlux(const Params &p, float hA, float terrainA, float hB, float terrainB,
+                      float qPrev, float q, float qNext) {
+    float etaA = hA + terrainA;
+    float etaB = hB + terrainB;
+    float terrainMax = terrainA < terrainB ? terrainB : terrainA;
+
+    bool wet = (etaA > terrainMax + p.dryEps) || (etaB > terrainMax + p.dryEps);
+    if (!wet)
+        return 0.0f;
+
+    float h_upwind = upwindedHeight(p, etaA, etaB, terrainMax, q);
+    if (h_upwind <= p.dryEps)
+        return 0.0f;
+
+    float h_avg = 0.5f * (hA + hB);
+
+    float pressure = -p.gravity * (etaB - etaA) / p.dx;
+
+    //advection
+    float u_face = q / h_upwind;
+    float advection = (u_face > 0.0f) ? -u_face * (q - qPrev) / p.dx
+                                      : -u_face * (qNext - q) / p.dx;
+
+    float friction = -p.friction_coef * u_face * std::abs(u_face) / h_upwind;
+
+    float accel = pressure + friction;
+    float dqdt = h_avg * accel + advection;
+
+    float qNew = q + dqdt * p.dt;
+
+    float max_q = h_upwind * p.limitCFL;
+    qNew = qNew < -max_q ? -max_q : qNew;
+    return max_q < qNew ? max_q : qNew;
+}
+
+static inline float faceVelocity(const Params &p, float hA, float terrainA, float hB, float terrainB, float q) {
+    float etaA = hA + terrainA;
+    float etaB = hB + terrainB;
+    float terrainMax = terrainA < terrainB ? terrainB : terrainA;
+
+    float h_upwind = upwindedHeight(p, etaA, etaB, terrainMax, q);
+    return (h_upwind > p.dryEps) ? q / h_upwind : 0.0f;
+}
+
+static inline float cellHeight(const Params &p, float h, float qxl, float qxr, float qyb, float qyt) {
+    float div_x = (qxr - qxl) / p.dx;
+    float div_y = (qyt - qyb) / p.dx;
+
+    float total_divergence = div_x + div_y;
+
+    h -= total_divergence * p.dt;
+    return 0.0f < h ? h : 0.0f;
+}
+
+// paramètres du membre de la lane, pour les versions scalaires des noyaux d'ensemble
+static inline Params memberParams(const Params &p, const EnsembleParams &e, int lane) {
+    Params m = p;
+    m.dryEps = e.dryEps[lane];
+    m.gravity = e.gravity[lane];
+    m.friction_coef = e.friction_coef[lane];
+    return m;
+}
+
+// Conversions scalaires fp16 / bf16, mêmes résultats que F16C (vcvtps2ph en arrondi au plus proche) et que les
+// versions SIMD de bf16. Utilisées par la table scalaire et pour les fins de ligne.
+
+static inline std::uint16_t floatToHalf(float f) {
+    std::uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    const std::uint32_t sign = (x >> 16) & 0x8000u;
+    const std::uint32_t absx = x & 0x7fffffffu;
+
+    if (absx > 0x7f800000u) // NaN, rendu silencieux
+        return static_cast<std::uint16_t>(sign | 0x7e00u | ((absx >> 13) & 0x3ffu));
+    if (absx >= 0x47800000u) // >= 65536 (et inf) : inf
+        return static_cast<std::uint16_t>(sign | 0x7c00u);
+    if (absx < 0x38800000u) { // sous-normal en fp16 (< 2^-14)
+        if (absx <= 0x33000000u) // <= 2^-25 : arrondi vers 0
+            return static_cast<std::uint16_t>(sign);
+        const std::uint32_t mantissa = (absx & 0x7fffffu) | 0x800000u;
+        const int shift = 126 - static_cast<int>(absx >> 23);
+        std::uint32_t r = mantissa >> shift;
+        const std::uint32_t rest = mantissa & ((1u << shift) - 1u);
+        const std::uint32_t half = 1u << (shift - 1);
+        r += (rest > half || (rest == half && (r & 1u))) ? 1u : 0u;
+        return static_cast<std::uint16_t>(sign | r);
+    }
+
+    // normal : changement de biais de l'exposant, la retenue de l'arrondi peut donner inf (>= 65520)
+    const std::uint32_t r = absx - 0x38000000u;
+    return static_cast<std::uint16_t>(sign | ((r + 0xfffu + ((r >> 13) & 1u)) >> 13));
+}
+
+static inline float halfToFloat(std::uint16_t hv) {
+    const std::uint32_t sign = static_cast<std::uint32_t>(hv & 0x8000u) << 16;
+    const std::uint32_t exponent = (hv >> 10) & 0x1fu;
+    const std::uint32_t mantissa = hv & 0x3ffu;
+
+    std::uint32_t x;
+    if (exponent == 0x1fu) {
+        x = sign | 0x7f800000u | (mantissa << 13) | (mantissa ? 0x400000u : 0u);
+    } else if (exponent == 0) {
+        // sous-normal : mantissa * 2^-24, exact en float
+        float f = static_cast<float>(mantissa) * 5.9604644775390625e-8f;
+        std::memcpy(&x, &f, sizeof(x));
+        x |= sign;
+    } else {
+        x = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+    }
+
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+static inline std::uint16_t floatToBFloat16(float f) {
+    std::uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    if ((x & 0x7fffffffu) > 0x7f800000u) // NaN, rendu silencieux
+        return static_cast<std::uint16_t>((x >> 16) | 0x40u);
+    return static_cast<std::uint16_t>((x + 0x7fffu + ((x >> 16) & 1u)) >> 16);
+}
+
+static inline float bfloat16ToFloat(std::uint16_t b) {
+    const std::uint32_t x = static_cast<std::uint32_t>(b) << 16;
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+// Corps générique des noyaux SIMD. V enveloppe un jeu d'instructions (voir ShallowWaterCPUKernels*.cpp) et fournit :
+// Reg, Mask, width, load, store, set1, add, sub, mul, div, max(a, b) = a > b ? a : b, min(a, b) = a < b ? a : b,
+// abs, neg, lt, le, gt, ge, orMask, andMask, select(m, a, b) = m ? a : b, zeroIfNot(m, a) = m ? a : +0.
+template <class V> struct SimdKernels {
+    using Reg = typename V::Reg;
+    using Mask = typename V::Mask;
+
+    struct Constants {
+        Reg zero, half, dryEps, dx, dt, gravityNeg, frictionNeg, limitCFL;
+
+        explicit Constants(const Params &p)
+            : zero(V::set1(0.0f)), half(V::set1(0.5f)), dryEps(V::set1(p.dryEps)), dx(V::set1(p.dx)),
+              dt(V::set1(p.dt)), gravityNeg(V::set1(-p.gravity)), frictionNeg(V::set1(-p.friction_coef)),
+              limitCFL(V::set1(p.limitCFL)) {}
+
+        // ensemble : paramètres des membres des lanes [lane, lane + width)
+        Constants(const Params &p, const EnsembleParams &e, int lane)
+            : zero(V::set1(0.0f)), half(V::set1(0.5f)), dryEps(V::load(e.dryEps + lane)), dx(V::set1(p.dx)),
+              dt(V::set1(p.dt)), gravityNeg(V::neg(V::load(e.gravity + lane))),
+              frictionNeg(V::neg(V::load(e.friction_coef + lane))), limitCFL(V::set1(p.limitCFL)) {}
+    };
+
+    static Reg upwindedHeight(const Constants &c, Reg etaA, Reg etaB, Reg terrainMax, Reg q) {
+        Reg hA = V::max(V::sub(etaA, terrainMax), c.zero);
+        Reg hB = V::max(V::sub(etaB, terrainMax), c.zero);
+        Reg calm = V::max(hB, hA);
+        Reg upwind = V::select(V::ge(q, c.zero), hA, hB);
+        return V::select(V::lt(V::abs(q), c.dryEps), calm, upwind);
+    }
+
+    static Reg faceFlux(const Constants &c, Reg hA, Reg terrainA, Reg hB, Reg terrainB, Reg qPrev, Reg q,
+                        Reg qNext) {
+        Reg etaA = V::add(hA, terrainA);
+        Reg etaB = V::add(hB, terrainB);
+        Reg terrainMax = V::max(terrainB, terrainA);
+
+        Reg wetLevel = V::add(terrainMax, c.dryEps);
+        Mask wet = V::orMask(V::gt(etaA, wetLevel), V::gt(etaB, wetLevel));
+
+        Reg h_upwind = upwindedHeight(c, etaA, etaB, terrainMax, q);
+        Mask active = V::andMask(wet, V::gt(h_upwind, c.dryEps));
+
+        Reg h_avg = V::mul(c.half, V::add(hA, hB));
+        Reg pressure = V::div(V::mul(c.gravityNeg, V::sub(etaB, etaA)), c.dx);
+
+        Reg u_face = V::div(q, h_upwind);
+        Reg uNeg = V::neg(u_face);
+        Reg gradient = V::select(V::gt(u_face, c.zero), V::sub(q, qPrev), V::sub(qNext, q));
+        Reg advection = V::div(V::mul(uNeg, gradient), c.dx);
+
+        Reg friction = V::div(V::mul(V::mul(c.frictionNeg, u_face), V::abs(u_face)), h_upwind);
+
+        Reg accel = V::add(pressure, friction);
+        Reg dqdt = V::add(V::mul(h_avg, accel), advection);
+        Reg qNew = V::add(q, V::mul(dqdt, c.dt));
+
+        Reg max_q = V::mul(h_upwind, c.limitCFL);
+        qNew = V::max(V::neg(max_q), qNew);
+        qNew = V::min(max_q, qNew);
+
+        return V::zeroIfNot(active, qNew);
+    }
+
+    static void fluxX(const Params &p, const float *h, const float *terrain, const float *qx, float *qxNew,
+                      int i0, int i1) {
+        const Constants c{p};
+        int i = i0;
+        for (; i + V::width <= i1; i += V::width) {
+            Reg q = faceFlux(c, V::load(h + i - 1), V::load(terrain + i - 1), V::load(h + i),
+                             V::load(terrain + i), V::load(qx + i - 1), V::load(qx + i), V::load(qx + i + 1));
+            V::store(qxNew + i, q);
+        }
+        for (; i < i1; ++i)
+            qxNew[i] = ShallowWaterKernels::faceFlux(p, h[i - 1], terrain[i - 1], h[i], terrain[i], qx[i - 1],
+                                                     qx[i], qx[i + 1]);
+    }
+
+    static void fluxY(const Params &p, const float *hB, const float *terrainB, const float *hT,
+                      const float *terrainT, const float *qyB, const float *qyC, const float *qyT, float *qyNew,
+                      int i0, int i1) {
+        const Constants c{p};
+        int i = i0;
+        for (; i + V::width <= i1; i += V::width) {
+            Reg q = faceFlux(c, V::load(hB + i), V::load(terrainB + i), V::load(hT + i), V::load(terrainT + i),
+                             V::load(qyB + i), V::load(qyC + i), V::load(qyT + i));
+            V::store(qyNew + i, q);
+        }
+        for (; i < i1; ++i)
+            qyNew[i] = ShallowWaterKernels::faceFlux(p, hB[i], terrainB[i], hT[i], terrainT[i], qyB[i], qyC[i],
+                                                     qyT[i]);
+    }
+
+    static void height(const Params &p, float *h, const float *qx, const float *qyB, const float *qyT, int i0,
+                       int i1) {
+        const Constants c{p};
+        int i = i0;
+        for (; i + V::width <= i1; i += V::width) {
+            Reg div_x = V::div(V::sub(V::load(qx + i + 1), V::load(qx + i)), c.dx);
+            Reg div_y = V::div(V::sub(V::load(qyT + i), V::load(qyB + i)), c.dx);
+            Reg newH = V::sub(V::load(h + i), V::mul(V::add(div_x, div_y), c.dt));
+            V::store(h + i, V::max(newH, c.zero));
+        }
+        for (; i < i1; ++i)
+            h[i] = ShallowWaterKernels::cellHeight(p, h[i], qx[i], qx[i + 1], qyB[i], qyT[i]);
+    }
+
+    static void velocity(const Params &p, const float *hA, const float *terrainA, const float *hB,
+                         const float *terrainB, const float *q, float *u, int i0, int i1) {
+        const Constants c{p};
+        int i = i0;
+        for (; i + V::width <= i1; i += V::width) {
+            Reg etaA = V::add(V::load(hA + i), V::load(terrainA + i));
+            Reg etaB = V::add(V::load(hB + i), V::load(terrainB + i));
+            Reg terrainMax = V::max(V::load(terrainB + i), V::load(terrainA + i));
+            Reg qi = V::load(q + i);
+            Reg h_upwind = upwindedHeight(c, etaA, etaB, terrainMax, qi);
+            V::store(u + i, V::zeroIfNot(V::gt(h_upwind, c.dryEps), V::div(qi, h_upwind)));
+        }
+        for (; i < i1; ++i)
+            u[i] = ShallowWaterKernels::faceVelocity(p, hA[i], terrainA[i], hB[i], terrainB[i], q[i]);
+    }
+
+    static void ensembleFlux(const Params &p, const EnsembleParams &e, const float *hA, const float *terrainA,
+                             const float *hB, const float *terrainB, const float *qPrev, const float *q,
+                             const float *qNext, float *qNew, int n) {
+        int f = 0;
+        int lane = 0;
+        for (; f + V::width <= n; f += V::width) {
+            const Constants c{p, e, lane};
+            V::store(qNew + f, faceFlux(c, V::load(hA + f), V::load(terrainA + f), V::load(hB + f),
+                                        V::load(terrainB + f), V::load(qPrev + f), V::load(q + f),
+                                        V::load(qNext + f)));
+            lane += V::width;
+            if (lane == e.period)
+                lane = 0;
+        }
+        for (; f < n; ++f)
+            qNew[f] = ShallowWaterKernels::faceFlux(memberParams(p, e, f % e.period), hA[f], terrainA[f], hB[f],
+                                                    terrainB[f], qPrev[f], q[f], qNext[f]);
+    }
+
+    static void ensembleHeight(const Params &p, float *h, const float *qL, const float *qR, const float *qB,
+                               const float *qT, int n) {
+        const Constants c{p};
+        int f = 0;
+        for (; f + V::width <= n; f += V::width) {
+            Reg div_x = V::div(V::sub(V::load(qR + f), V::load(qL + f)), c.dx);
+            Reg div_y = V::div(V::sub(V::load(qT + f), V::load(qB + f)), c.dx);
+            Reg newH = V::sub(V::load(h + f), V::mul(V::add(div_x, div_y), c.dt));
+            V::store(h + f, V::max(newH, c.zero));
+        }
+        for (; f < n; ++f)
+            h[f] = ShallowWaterKernels::cellHeight(p, h[f], qL[f], qR[f], qB[f], qT[f]);
+    }
+
+    static Table makeTable(const char *name, PackFn packHalf, UnpackFn unpackHalf, PackFn packBFloat16,
+                           UnpackFn unpackBFloat16) {
+        return Table{name,       fluxX,        fluxY,          height,      velocity,      packHalf,
+                     unpackHalf, packBFloat16, unpackBFloat16, ensembleFlux, ensembleHeight};
+    }
+};
+
+} // namespace ShallowWaterKernels
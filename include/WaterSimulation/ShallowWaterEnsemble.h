@@ -0,0 +1,101 @@
+#pragma once
+
+#include <WaterSimulation/ShallowWater.h>
+
+#include <Magnum/GL/AbstractShaderProgram.h>
+#include <Magnum/GL/Buffer.h>
+#include <Magnum/GL/Texture.h>
+#include <Magnum/GL/TextureArray.h>
+#include <Magnum/Magnum.h>
+#include <Magnum/Trade/ImageData.h>
+#include <cstddef>
+#include <vector>
+
+// Ensemble de variantes du solveur GPU sur un même terrain (études de sensibilité). Chaque membre est une couche
+// d'un Texture2DArray, tous les membres avancent dans le même dispatch (z = membre) et lisent leurs paramètres
+// dans un SSBO. Shallow water seul (chemin airyWavesEnabled = false de ShallowWater), mêmes shaders compilés
+// avec ENSEMBLE.
+class ShallowWaterEnsemble {
+  public:
+    // paramètres propres à un membre, valeurs par défaut de ShallowWater. Même disposition que Member dans les shaders.
+    struct Member {
+        float gravity = 9.81f;
+        float friction_coef = 0.01f;
+        float dryEps = 1e-3f;
+        float levelOffset = 0.0f; // ajouté aux niveaux d'eau de init.comp
+    };
+
+    using StoragePrecision = ShallowWater::StoragePrecision;
+
+  private:
+    int nx, ny;
+    float dx;
+    float dt; // commun à tous les membres
+    int groupx, groupy;
+    StoragePrecision m_precision = StoragePrecision::Float32;
+
+    std::vector<Member> m_members;
+
+    Magnum::GL::Texture2DArray m_stateTexture; // (h, qx, qy) de chaque membre, une couche par membre
+    Magnum::GL::Texture2DArray m_stateTexturePong;
+    Magnum::GL::Texture2D m_terrainTexture; // partagé par tous les membres
+    Magnum::GL::Buffer m_memberBuffer;      // binding 4
+    Magnum::GL::Buffer m_massBuffer;        // binding 3, sommes partielles de totalVolumes
+
+    struct ComputeProgram : public Magnum::GL::AbstractShaderProgram {
+        ComputeProgram() = default;
+        ComputeProgram(Magnum::Containers::StringView filepath, StoragePrecision precision);
+
+        ComputeProgram &setFloatUniform(const char *name, float value) {
+            setUniform(uniformLocation(name), value);
+            return *this;
+        }
+
+        ComputeProgram &setIntUniform(const char *name, int value) {
+            setUniform(uniformLocation(name), value);
+            return *this;
+        }
+
+        // un groupe de 16 x 16 cellules par membre
+        ComputeProgram &run(unsigned int gx, unsigned int gy, unsigned int members) {
+            dispatchCompute({gx, gy, members});
+            return *this;
+        }
+    };
+
+    ComputeProgram m_updateProgram; // flux et hauteur en un dispatch (updateFluxesHeight.comp)
+    ComputeProgram m_initProgram;
+    ComputeProgram m_totalMassProgram;
+
+    Magnum::GL::ImageFormat stateImageFormat() const;
+    void init(int initType);
+
+  public:
+    ShallowWaterEnsemble(size_t nx_, size_t ny_, float dx_, float dt_, std::vector<Member> members, int groups = 16,
+                         StoragePrecision precision = StoragePrecision::Float32);
+
+    void step(); // un pas pour tous les membres, un seul dispatch
+    void setTimestep(float dt_) { dt = dt_; }
+    float getdt() const { return dt; }
+
+    int size() const { return static_cast<int>(m_members.size()); }
+    const Member &member(int k) const { return m_members[k]; }
+    int getnx() const { return nx; }
+    int getny() const { return ny; }
+
+    // même conversion que ShallowWater::loadTerrainHeightMap, une seule texture pour tout l'ensemble
+    void loadTerrainHeightMap(Magnum::Trade::ImageData2D *img, float scaling = 1.0f, int channels = 1);
+
+    void initBump();
+    void initDamBreak();
+    void initTsunami();
+
+    // volume d'eau de chaque membre, bloque jusqu'au résultat
+    std::vector<double> totalVolumes();
+
+    // octets des textures et buffers de l'ensemble, voir ShallowWater::memoryUsage
+    std::size_t memoryUsage();
+
+    Magnum::GL::Texture2DArray &getStateTexture() { return m_stateTexture; }
+    Magnum::GL::Texture2D &getTerrainTexture() { return m_terrainTexture; }
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <WaterSimulation/PaddedGrid.h>
+#include <WaterSimulation/ShallowWaterCPUKernels.h>
+#include <WaterSimulation/ThreadPool.h>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <Magnum/Magnum.h>
+#include <Magnum/Trade/ImageData.h>
+
+// Ensemble de variantes du solveur CPU sur un même terrain, pour les études de sensibilité (gravité, frottement,
+// dryEps, niveau d'eau initial). Les K membres sont avancés ensemble : leurs grilles sont entrelacées cellule par
+// cellule (voir EnsembleParams dans ShallowWaterCPUKernels.h), une lane SIMD porte un membre et chaque passe ne
+// parcourt la grille qu'une fois pour tous les membres. Le terrain est chargé une fois et partagé.
+// Chaque membre donne exactement le résultat d'un ShallowWaterCPU seul avec les mêmes paramètres (passes globales).
+class ShallowWaterEnsembleCPU {
+public:
+    //paramètres propres à un membre, valeurs par défaut de ShallowWaterCPU
+    struct Member {
+        float gravity = 9.81f;
+        float friction_coef = 0.2f;
+        float dryEps = 1e-3f;
+        float levelOffset = 0.0f; //ajouté au niveau d'eau de initBump / initTop
+    };
+
+private:
+    int nx, ny; //nombre de cellules sur chaque axe
+    float dx; //l'écart entre les cellules
+    float dt; //le pas de temps, commun à tous les membres
+    float limitCFL;
+
+    std::vector<Member> members;
+    int memberCount = 0; //K, la largeur d'une cellule dans les grilles entrelacées
+
+    //paramètres répétés par lane, voir EnsembleParams
+    int lanePeriod = 0;
+    std::vector<float> laneDryEps, laneGravity, laneFriction;
+
+    //mêmes grilles que ShallowWaterCPU, de largeur nx * K (resp. (nx + 1) * K) : la valeur du membre m de la
+    //cellule (i, j) est row(j)[i * K + m]. Le terrain est recopié pour chaque membre pour être lu comme l'état.
+    PaddedGrid h;
+    PaddedGrid qx, qy;
+    PaddedGrid qxNext, qyNext;
+    PaddedGrid terrain;
+
+    std::unique_ptr<ThreadPool> pool; //threads de calcul, nullptr = mono-thread
+    void parallelRows(int begin, int end, const std::function<void(int, int)> &fn);
+
+    const ShallowWaterKernels::Table *kernels = &ShallowWaterKernels::table();
+    ShallowWaterKernels::Params kernelParams() const; //parties communes (dx, dt, limitCFL)
+    ShallowWaterKernels::EnsembleParams ensembleParams() const;
+
+    void updateFluxes();
+    void updateWaterHeight();
+
+public:
+    ShallowWaterEnsembleCPU() = default;
+
+    //threads = 0 : un thread par coeur, threads = 1 : mono-thread
+    ShallowWaterEnsembleCPU(size_t nx_, size_t ny_, float dx_, float dt_, std::vector<Member> members_,
+                            unsigned threads = 0, bool hugePages = false);
+
+    void step(); //un pas pour tous les membres
+    void advance(int stepCount);
+
+    int size() const { return memberCount; }
+    const Member &member(int k) const { return members[k]; }
+
+    void setTimestep(float dt_); //met aussi à jour limitCFL
+    float getdt() const { return dt; }
+
+    void setThreadCount(unsigned threads);
+    unsigned threadCount() const { return pool ? pool->size() : 1; }
+    void setKernelIsa(ShallowWaterKernels::Isa isa);
+    const char *kernelName() const { return kernels->name; }
+    std::size_t memoryUsage() const; //octets alloués par les grilles
+
+    int getnx() const { return nx; }
+    int getny() const { return ny; }
+
+    //terrain commun : lu une fois dans l'image (même format que ShallowWaterCPU) ou copié d'une grille nx x ny
+    void loadTerrainHeightMap(Magnum::Trade::ImageData2D *img, float scaling = 1.0f);
+    void setTerrain(const PaddedGrid &source);
+
+    //initialisation, comme ShallowWaterCPU avec le niveau d'eau décalé de levelOffset pour chaque membre
+    void initBump();
+    void initTop();
+
+    float waterHeight(int k, int i, int j) const { return h.at(i * memberCount + k, j); }
+    void copyWaterHeight(int k, PaddedGrid &out) const; //h du membre k dans une grille nx x ny
+    double totalVolume(int k) const; //somme des h * dx², en double
+};
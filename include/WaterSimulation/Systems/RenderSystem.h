@@ -12,6 +12,7 @@
 #include <WaterSimulation/Rendering/GodRayPass.h>
 #include <WaterSimulation/Rendering/CompositionPass.h>
 #include <WaterSimulation/Rendering/HeightmapReadback.h>
+#include <WaterSimulation/GpuProfiler.h>
 
 
 #include <Magnum/GL/AbstractShaderProgram.h>
@@ -65,6 +66,7 @@ namespace WaterSimulation {
 		}
 
 		void setHeightmapReadback(HeightmapReadback* hb) { m_heightmapReadback = hb; }
+		void setProfiler(GpuProfiler* profiler) { m_profiler = profiler; }
 
 		void visualizeHeightmap(Registry& registry, const Magnum::Matrix4& viewProj);
 
@@ -76,6 +78,7 @@ namespace WaterSimulation {
 		CompositionPass m_compositionPass;
 
 		HeightmapReadback * m_heightmapReadback{nullptr};
+		GpuProfiler * m_profiler{nullptr}; // une section par passe de rendu
 
 
 		FullscreenTextureShader m_fullScreenTextureShader;
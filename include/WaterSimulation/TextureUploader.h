@@ -0,0 +1,34 @@
+#pragma once
+
+#include <Magnum/GL/BufferImage.h>
+#include <Magnum/GL/Texture.h>
+#include <Magnum/Magnum.h>
+#include <Magnum/PixelFormat.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Envoi de pixels calculés sur le CPU vers une texture, par un anneau de pixel unpack buffers.
+// map() donne la mémoire du prochain buffer de l'anneau (orphelinée, pas d'attente sur un envoi en cours),
+// upload() la démappe et lance la copie buffer -> texture, qui rend la main sans attendre le GPU : la copie
+// recouvre le pas suivant. Le pendant lecture est Rendering/HeightmapReadback.
+// Les buffers sont créés au premier map(), il faut donc un contexte GL courant à ce moment là.
+class TextureUploader {
+  public:
+    static constexpr int ringSize = 3;
+
+    // mémoire du prochain envoi, lignes serrées (alignement 1) de size.x() pixels de format
+    std::uint8_t *map(Magnum::PixelFormat format, const Magnum::Vector2i &size);
+
+    // démappe le buffer de map() et le copie dans le niveau 0 de texture
+    void upload(Magnum::GL::Texture2D &texture);
+
+  private:
+    std::vector<Magnum::GL::BufferImage2D> m_ring;
+    Magnum::PixelFormat m_format{};
+    Magnum::Vector2i m_size{0};
+    std::size_t m_byteSize = 0;
+    int m_index = 0;
+    bool m_mapped = false;
+};
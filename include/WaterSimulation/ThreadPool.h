@@ -0,0 +1,49 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pool de threads persistant, utilisé par le solveur CPU pour découper les grilles en bandes de lignes.
+// Les workers restent en vie entre les appels, un parallelFor ne coûte donc qu'un réveil + une attente.
+class ThreadPool {
+  public:
+    // threadCount = 0 : autant de threads que de coeurs matériels
+    explicit ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // nombre total de threads qui participent, thread appelant compris
+    unsigned size() const { return static_cast<unsigned>(m_workers.size()) + 1; }
+
+    // Découpe [begin, end) en size() bandes contiguës et appelle fn(bandBegin, bandEnd) sur chacune.
+    // Le découpage ne dépend que de (begin, end, size()), bloque jusqu'à la fin de toutes les bandes.
+    void parallelFor(int begin, int end, const std::function<void(int, int)> &fn);
+
+    // indice (< size()) de la bande de parallelFor(begin, end) qui commence à la ligne bandBegin, pour donner à
+    // chaque bande sa tranche d'un tampon partagé
+    unsigned bandIndex(int begin, int end, int bandBegin) const;
+
+  private:
+    static int bandStart(int begin, int end, unsigned bands, unsigned index);
+    void workerLoop(unsigned index);
+    void runBand(unsigned index);
+
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+
+    const std::function<void(int, int)> *m_task = nullptr;
+    int m_begin = 0;
+    int m_end = 0;
+    std::size_t m_generation = 0; // incrémenté à chaque parallelFor pour réveiller les workers
+    unsigned m_pending = 0;       // workers qui n'ont pas encore fini la tâche courante
+    bool m_stop = false;
+};
@@ -12,6 +12,7 @@
 #include <Corrade/Containers/Pointer.h>
 
 #include <WaterSimulation/ShallowWater.h>
+#include <WaterSimulation/GpuProfiler.h>
 #include <string.h>
 #include <Corrade/Containers/StringView.h>
 #include <Corrade/PluginManager/Manager.h>
@@ -51,6 +52,7 @@ namespace WaterSimulation {
         void sceneGraph();
         void cameraWindow(Camera & cam);
         void visualWindow(Magnum::Platform::Sdl2Application & app);
+        void perfWindow(GpuProfiler & profiler);
 
         
     };
@@ -27,6 +27,7 @@
 #include <Corrade/PluginManager/Manager.h>
 #include <Magnum/Trade/AbstractImporter.h>
 #include <WaterSimulation/ShallowWater.h>
+#include <WaterSimulation/GpuProfiler.h>
 #include <WaterSimulation/Systems/RenderSystem.h>
 
 
@@ -45,6 +46,7 @@ namespace WaterSimulation {
 			int step_number = 1; //number of shallow water steps for a single time step, increasing this increases water speed
 
 			ShallowWater& shallowWaterSimulation() { return m_shallowWaterSimulation; }
+			GpuProfiler& gpuProfiler() { return m_gpuProfiler; }
 
 			Registry & registry(){ return m_registry; };
 
@@ -74,8 +76,10 @@ namespace WaterSimulation {
 			std::unique_ptr<Mesh> m_terrainMesh;
 
 			HeightmapReadback m_heightmapReadback;
+			std::vector<ShallowWater::Disturbance> m_wakeDisturbances; // perturbations de tous les sous-pas d'une frame
 
 			ShallowWater m_shallowWaterSimulation; // simulation de l'eau
+			GpuProfiler m_gpuProfiler; // temps GPU des passes de simulation et de rendu, fenêtre "GPU Profiler"
 			Magnum::GL::Texture2D m_heightTexture; // carte des hauteurs de l'eau, affiché dans imgui
 			Magnum::GL::Texture2D m_momentumTexture; // carte des velocités u ou des q
 			Magnum::GL::Texture2D m_terrainHeightmap; // heightmap du terrain
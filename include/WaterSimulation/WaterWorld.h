@@ -0,0 +1,92 @@
+#pragma once
+
+#include <WaterSimulation/ShallowWater.h>
+
+#include <Magnum/Magnum.h>
+#include <Magnum/Math/Vector2.h>
+#include <Magnum/Trade/ImageData.h>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Monde en grille de tilesX x tilesY solveurs ShallowWater de (tileCells + 1)² texels, pour un domaine plus grand
+// qu'une seule texture. Deux tuiles voisines se recouvrent sur 2 * HaloWidth texels : chacune possède la moitié du
+// recouvrement de son côté et reçoit l'autre moitié (son halo) de sa voisine après chaque pas, par
+// glCopyImageSubData. Le pas ne dépend que des cellules à deux près, le halo couvre donc la cellule de bord (mur) de
+// la tuile et ce qu'elle contamine en un pas : les cellules possédées sont celles d'un seul grand solveur.
+// Shallow water seul, les ondes d'Airy (FFT sur toute la tuile) ne se raccordent pas d'une tuile à l'autre.
+//
+// Mise en sommeil, vérifiée tous les sleepCheckSteps pas : une tuile dort si elle est sèche (aucune tuile 16 x 16
+// active au dernier pas) et qu'aucune de ses huit voisines n'est mouillée, ou si elle est loin de la zone
+// d'intérêt. Une tuile endormie n'avance plus et garde son état ; loin de l'intérêt, même mouillée, elle sert de
+// bord figé à ses voisines éveillées. sleepCheckSteps doit rester sous le nombre de pas qu'il faut à l'eau pour
+// traverser une tuile.
+class WaterWorld {
+  public:
+    static constexpr int HaloWidth = 4;
+
+    WaterWorld(int tilesX, int tilesY, std::size_t tileCells, float dx, float dt,
+               ShallowWater::StoragePrecision precision = ShallowWater::StoragePrecision::Float32);
+
+    int tilesX() const { return m_tilesX; }
+    int tilesY() const { return m_tilesY; }
+    // texels du monde, premier texel d'une tuile et cellules qu'elle possède [min, max)
+    Magnum::Vector2i size() const;
+    Magnum::Vector2i tileOrigin(int x, int y) const;
+    std::pair<Magnum::Vector2i, Magnum::Vector2i> ownedRange(int x, int y) const;
+
+    ShallowWater &tile(int x, int y) { return m_tiles[std::size_t(y * m_tilesX + x)]; }
+    bool isAwake(int x, int y) const { return m_awake[std::size_t(y * m_tilesX + x)]; }
+    int awakeTileCount() const;
+
+    // image de size() texels, découpée entre les tuiles
+    void loadTerrainHeightMap(Magnum::Trade::ImageData2D *image, float scaling = 1.0f, int channels = 1);
+    void initEmpty();
+
+    // sources en cellules du monde. createWater va à toutes les tuiles que le disque touche, arrivées d'eau et puits
+    // à la tuile qui possède leur centre : leur disque doit tenir dans ses cellules possédées
+    void createWater(float x, float y, float radius, float quantity);
+    int addInflow(float x, float y, float radius, std::vector<Magnum::Vector2> hydrograph);
+    int addDrain(float x, float y, float radius, float rate);
+    void removeSource(int id);
+
+    // zone d'intérêt (caméra, objets suivis) en cellules du monde, rayon infini par défaut
+    void setInterest(const Magnum::Vector2 &center, float radius);
+
+    // comme ShallowWater::advanceTime, avec un dt commun à toutes les tuiles éveillées
+    int advanceTime(float simulatedTime);
+    void step(); // un pas des tuiles éveillées puis échange des halos
+    void updateSleep(); // relit l'état sec des tuiles éveillées (bloquant) et recalcule les tuiles éveillées
+
+    // somme des cellules possédées, relue depuis le GPU
+    double totalVolume();
+
+    // somme des ShallowWater::memoryUsage des tuiles
+    std::size_t memoryUsage();
+
+    bool adaptiveTimestep = false;
+    float cflNumber = 0.5f;
+    int maxSubsteps = 64;
+    int sleepCheckSteps = 32;
+
+  private:
+    std::size_t index(int x, int y) const { return std::size_t(y * m_tilesX + x); }
+    // tuile qui possède la cellule (x, y) du monde
+    Magnum::Vector2i owner(float x, float y) const;
+    void updateAwake();
+    // copie des halos entre voisines dont une au moins est éveillée, ou toutes
+    void exchangeHalos(bool all);
+
+    int m_tilesX, m_tilesY;
+    int m_tileTexels; // tileCells + 1
+    float m_dx, m_maxDt;
+    std::vector<ShallowWater> m_tiles;
+    std::vector<bool> m_awake;
+    std::vector<bool> m_wet;
+
+    Magnum::Vector2 m_interestCenter;
+    float m_interestRadius;
+    int m_stepsSinceCheck = 0;
+
+    std::vector<std::pair<std::size_t, int>> m_sources; // (tuile, identifiant dans la tuile) par identifiant du monde
+};
@@ -0,0 +1,13 @@
+// Variante des programmes de ShallowWater lancée par glDispatchComputeIndirect sur la liste de activeTiles.comp :
+// un groupe par tuile active, workGroup() rend la position de la tuile dans la grille de groupes.
+#define ACTIVE_TILES
+
+layout(std430, binding = 7) readonly buffer ActiveTiles {
+    uvec4 activeTileDispatch;
+    uint activeTiles[]; // x | y << 16
+};
+
+uvec2 workGroup() {
+    uint tile = activeTiles[gl_WorkGroupID.x];
+    return uvec2(tile & 0xffffu, tile >> 16);
+}
@@ -0,0 +1,15 @@
+// Paramètres de la simulation, ajoutés en tête de chaque programme de ShallowWater (ShallowWater::Parameters).
+// Renvoyés au GPU seulement quand une valeur change (slider de l'UI, nouveau dt) au lieu d'un glUniform par
+// paramètre et par programme à chaque dispatch.
+layout(std140, binding = 0) uniform SimulationParameters {
+    float dx;
+    float dt;
+    float gravity;
+    float dryEps;
+    float friction_coef;
+    float decompositionD;
+    float hBar;                  // airyHBar
+    float transportGamma;
+    float diffusionIterations;   // force de la diffusion de la décomposition, en pas explicites
+    float decompositionTolerance;
+};
@@ -0,0 +1,167 @@
+#include <WaterSimulation/ComputeGraph.h>
+#include <WaterSimulation/GpuProfiler.h>
+
+#include <Magnum/GL/Renderer.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+ComputeGraph::Resource ComputeGraph::import(Magnum::GL::Texture2D &texture) {
+    for (Resource r = 0; r < m_resources.size(); ++r)
+        if (m_resources[r].imported == &texture)
+            return r;
+
+    m_resources.push_back({&texture, {}, {}, -1, -1, 0});
+    return m_resources.size() - 1;
+}
+
+ComputeGraph::Resource ComputeGraph::transient(Magnum::GL::TextureFormat format, const Magnum::Vector2i &size) {
+    m_resources.push_back({nullptr, format, size, -1, -1, 0});
+    return m_resources.size() - 1;
+}
+
+void ComputeGraph::use(Resource resource) {
+    ResourceEntry &entry = m_resources[resource];
+    const int pass = int(m_passes.size());
+    if (entry.firstPass < 0)
+        entry.firstPass = pass;
+    entry.lastPass = pass;
+}
+
+void ComputeGraph::addPass(const char *name, std::initializer_list<Resource> reads,
+                           std::initializer_list<Resource> writes, std::function<void()> run, PassFlag flags) {
+    for (Resource r : reads)
+        use(r);
+    for (Resource r : writes)
+        use(r);
+    m_passes.push_back({name, reads, writes, std::move(run), flags});
+}
+
+void ComputeGraph::compile() {
+    // transitoires par première passe, chacune prend la première texture du pool libre à ce moment
+    std::vector<Resource> order;
+    for (Resource r = 0; r < m_resources.size(); ++r)
+        if (!m_resources[r].imported && m_resources[r].firstPass >= 0)
+            order.push_back(r);
+    std::stable_sort(order.begin(), order.end(), [&](Resource a, Resource b) {
+        return m_resources[a].firstPass < m_resources[b].firstPass;
+    });
+
+    for (PoolTexture &pooled : m_pool)
+        pooled.busyUntil = -1;
+
+    std::vector<std::size_t> poolIndex(m_resources.size());
+    for (Resource r : order) {
+        ResourceEntry &entry = m_resources[r];
+        std::size_t p = 0;
+        while (p < m_pool.size() && !(m_pool[p].format == entry.format && m_pool[p].size == entry.size &&
+                                      m_pool[p].busyUntil < entry.firstPass))
+            ++p;
+        if (p == m_pool.size()) {
+            m_pool.push_back({Magnum::GL::Texture2D{}, entry.format, entry.size, -1});
+            m_pool.back().texture.setStorage(1, entry.format, entry.size);
+        }
+        m_pool[p].busyUntil = entry.lastPass;
+        poolIndex[r] = p;
+    }
+
+    // une entrée de suivi des barrières par texture réelle : deux transitoires qui partagent une texture se
+    // synchronisent comme une seule image
+    m_physical.clear();
+    std::vector<std::size_t> poolPhysical(m_pool.size(), m_resources.size());
+    for (Resource r = 0; r < m_resources.size(); ++r) {
+        ResourceEntry &entry = m_resources[r];
+        if (entry.imported) {
+            entry.physical = m_physical.size();
+            m_physical.push_back({entry.imported, false, false});
+        } else if (entry.firstPass >= 0) {
+            std::size_t &physical = poolPhysical[poolIndex[r]];
+            if (physical == m_resources.size()) {
+                physical = m_physical.size();
+                m_physical.push_back({&m_pool[poolIndex[r]].texture, false, false});
+            }
+            entry.physical = physical;
+        }
+    }
+}
+
+bool ComputeGraph::needsBarrier(const Pass &pass) const {
+    for (Resource r : pass.reads)
+        if (m_physical[m_resources[r].physical].written)
+            return true;
+    for (Resource r : pass.writes) {
+        const Physical &physical = m_physical[m_resources[r].physical];
+        if (physical.written || physical.read)
+            return true;
+    }
+    return false;
+}
+
+void ComputeGraph::barrier() {
+    Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+    for (Physical &physical : m_physical)
+        physical.written = physical.read = false;
+    ++m_barrierCount;
+}
+
+void ComputeGraph::execute(GpuProfiler *profiler) {
+    compile();
+    m_barrierCount = 0;
+
+    const char *section = nullptr;
+    for (const Pass &pass : m_passes) {
+        // la barrière d'une passe compte dans sa section
+        if (profiler && (!section || std::strcmp(section, pass.name) != 0)) {
+            if (section)
+                profiler->end();
+            section = pass.name;
+            profiler->begin(section);
+        }
+
+        if (needsBarrier(pass))
+            barrier();
+
+        pass.run();
+
+        if (pass.flags & EndsWithBarrier) {
+            for (Physical &physical : m_physical)
+                physical.written = physical.read = false;
+            continue;
+        }
+        for (Resource r : pass.reads)
+            m_physical[m_resources[r].physical].read = true;
+        for (Resource r : pass.writes)
+            m_physical[m_resources[r].physical].written = true;
+    }
+
+    // les écritures du graphe doivent être visibles de ce qui suit (rendu, pas suivant)
+    if (std::any_of(m_physical.begin(), m_physical.end(), [](const Physical &p) { return p.written; }))
+        barrier();
+    if (section)
+        profiler->end();
+
+    m_lastPassCount = int(m_passes.size());
+    m_lastBarrierCount = m_barrierCount;
+    m_passes.clear();
+    m_resources.clear();
+    m_physical.clear();
+}
+
+Magnum::GL::Texture2D &ComputeGraph::texture(Resource resource) {
+    assert(resource < m_resources.size() && !m_physical.empty());
+    return *m_physical[m_resources[resource].physical].texture;
+}
+
+std::size_t ComputeGraph::poolBytes() const {
+    std::size_t bytes = 0;
+    for (const PoolTexture &pooled : m_pool) {
+        std::size_t texel = 16;
+        if (pooled.format == Magnum::GL::TextureFormat::RGBA16F || pooled.format == Magnum::GL::TextureFormat::RG32F)
+            texel = 8;
+        else if (pooled.format == Magnum::GL::TextureFormat::R32F)
+            texel = 4;
+        bytes += texel * std::size_t(pooled.size.x()) * std::size_t(pooled.size.y());
+    }
+    return bytes;
+}
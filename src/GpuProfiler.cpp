@@ -0,0 +1,138 @@
+#include <WaterSimulation/GpuProfiler.h>
+
+#include <algorithm>
+#include <cstdio>
+
+void GpuProfiler::beginFrame() {
+    if (!enabled) {
+        // requêtes d'avant la pause : ni relues ni mélangées à la reprise
+        for (Frame &frame : m_frames)
+            frame.used = 0;
+        m_open.clear();
+        return;
+    }
+
+    m_frame = (m_frame + 1) % ringSize;
+    Frame &frame = m_frames[m_frame];
+    if (frame.used)
+        resolve(frame);
+    frame.used = 0;
+    m_open.clear();
+}
+
+void GpuProfiler::begin(const char *name) {
+    if (!enabled)
+        return;
+
+    Frame &frame = m_frames[m_frame];
+    if (frame.used == frame.samples.size())
+        frame.samples.push_back({0, Magnum::GL::TimeQuery{Magnum::GL::TimeQuery::Target::Timestamp},
+                                 Magnum::GL::TimeQuery{Magnum::GL::TimeQuery::Target::Timestamp}, false});
+
+    Sample &sample = frame.samples[frame.used];
+    sample.section = sectionIndex(name);
+    sample.closed = false;
+    sample.begin.timestamp();
+    m_open.push_back(frame.used++);
+}
+
+void GpuProfiler::end() {
+    // un end() sans begin() dans la frame : activé en cours de section
+    if (!enabled || m_open.empty())
+        return;
+
+    Sample &sample = m_frames[m_frame].samples[m_open.back()];
+    m_open.pop_back();
+    sample.end.timestamp();
+    sample.closed = true;
+}
+
+GpuProfiler::Scope::Scope(GpuProfiler *profiler, const char *name) : m_profiler{profiler} {
+    if (m_profiler)
+        m_profiler->begin(name);
+}
+
+GpuProfiler::Scope::~Scope() {
+    if (m_profiler)
+        m_profiler->end();
+}
+
+std::size_t GpuProfiler::sectionIndex(const char *name) {
+    for (std::size_t i = 0; i < m_sections.size(); ++i)
+        if (m_sections[i].name == name)
+            return i;
+
+    m_sections.push_back({name, std::vector<float>(historySize, 0.0f)});
+    return m_sections.size() - 1;
+}
+
+void GpuProfiler::resolve(Frame &frame) {
+    // ringSize frames plus tard le résultat est en général là, sinon on ne l'attend pas
+    for (std::size_t i = 0; i < frame.used; ++i) {
+        Sample &sample = frame.samples[i];
+        if (!sample.closed || !sample.end.resultAvailable() || !sample.begin.resultAvailable()) {
+            ++m_droppedFrames;
+            return;
+        }
+    }
+
+    std::vector<double> ms(m_sections.size(), 0.0);
+    for (std::size_t i = 0; i < frame.used; ++i) {
+        Sample &sample = frame.samples[i];
+        if (sample.section >= ms.size())
+            continue;
+        ms[sample.section] +=
+            (sample.end.result<Magnum::UnsignedLong>() - sample.begin.result<Magnum::UnsignedLong>()) * 1e-6;
+    }
+
+    const std::size_t slot = m_resolvedFrames % historySize;
+    ++m_resolvedFrames;
+    const std::size_t count = std::min<std::size_t>(m_resolvedFrames, historySize);
+
+    for (std::size_t s = 0; s < m_sections.size(); ++s) {
+        Section &section = m_sections[s];
+        section.history[slot] = float(ms[s]);
+        section.last = float(ms[s]);
+
+        double sum = 0.0;
+        float max = 0.0f;
+        for (std::size_t i = 0; i < count; ++i) {
+            sum += section.history[i];
+            max = std::max(max, section.history[i]);
+        }
+        section.average = float(sum / count);
+        section.max = max;
+    }
+}
+
+void GpuProfiler::clear() {
+    // les requêtes en vol pointent sur les anciennes sections
+    for (Frame &frame : m_frames)
+        frame.used = 0;
+    m_open.clear();
+    m_sections.clear();
+    m_resolvedFrames = 0;
+    m_droppedFrames = 0;
+}
+
+bool GpuProfiler::writeCsv(const std::string &path) const {
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (!file)
+        return false;
+
+    std::fprintf(file, "frame");
+    for (const Section &section : m_sections)
+        std::fprintf(file, ",%s", section.name.c_str());
+    std::fprintf(file, "\n");
+
+    // de la plus ancienne frame gardée à la plus récente
+    const std::size_t count = std::min<std::size_t>(m_resolvedFrames, historySize);
+    for (std::size_t f = m_resolvedFrames - count; f < m_resolvedFrames; ++f) {
+        std::fprintf(file, "%zu", f);
+        for (const Section &section : m_sections)
+            std::fprintf(file, ",%.4f", section.history[f % historySize]);
+        std::fprintf(file, "\n");
+    }
+
+    return std::fclose(file) == 0;
+}
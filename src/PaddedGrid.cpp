@@ -0,0 +1,125 @@
+#include <WaterSimulation/PaddedGrid.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace {
+
+constexpr std::size_t hugePageSize = std::size_t{2} << 20;
+
+void *alignedAlloc(std::size_t bytes) {
+#if defined(_WIN32)
+    void *p = _aligned_malloc(bytes, PaddedGrid::alignment);
+#else
+    void *p = std::aligned_alloc(PaddedGrid::alignment, bytes);
+#endif
+    if (!p)
+        throw std::bad_alloc{};
+    return p;
+}
+
+void alignedFree(void *p) {
+#if defined(_WIN32)
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+} // namespace
+
+template <class T>
+BasicPaddedGrid<T>::BasicPaddedGrid(int width, int height, bool hugePages) : m_width(width), m_height(height) {
+    // 1 bloc à gauche (dont le dernier élément est le ghost i = -1), puis l'intérieur + le ghost i = width
+    m_stride = lanes + (width + 1 + lanes - 1) / lanes * lanes;
+    const std::size_t rows = static_cast<std::size_t>(height) + 2;
+    m_bytes = rows * m_stride * sizeof(T);
+
+#if defined(__linux__)
+    if (hugePages && m_bytes >= hugePageSize) {
+        const std::size_t mappedBytes = (m_bytes + hugePageSize - 1) / hugePageSize * hugePageSize;
+        void *p = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, mappedBytes, MADV_HUGEPAGE);
+            m_data = static_cast<T *>(p);
+            m_bytes = mappedBytes;
+            m_mapped = true;
+        }
+    }
+#else
+    static_cast<void>(hugePages);
+#endif
+    if (!m_data) {
+        m_bytes = (m_bytes + alignment - 1) / alignment * alignment;
+        m_data = static_cast<T *>(alignedAlloc(m_bytes));
+    }
+
+    m_origin = m_data + m_stride + lanes;
+    fill(T{});
+}
+
+template <class T> BasicPaddedGrid<T>::~BasicPaddedGrid() { release(); }
+
+template <class T> BasicPaddedGrid<T>::BasicPaddedGrid(BasicPaddedGrid &&other) noexcept { swap(other); }
+
+template <class T> BasicPaddedGrid<T> &BasicPaddedGrid<T>::operator=(BasicPaddedGrid &&other) noexcept {
+    if (this != &other) {
+        release();
+        swap(other);
+    }
+    return *this;
+}
+
+template <class T> void BasicPaddedGrid<T>::swap(BasicPaddedGrid &other) noexcept {
+    std::swap(m_data, other.m_data);
+    std::swap(m_origin, other.m_origin);
+    std::swap(m_bytes, other.m_bytes);
+    std::swap(m_width, other.m_width);
+    std::swap(m_height, other.m_height);
+    std::swap(m_stride, other.m_stride);
+    std::swap(m_mapped, other.m_mapped);
+}
+
+template <class T> void BasicPaddedGrid<T>::release() {
+    if (!m_data)
+        return;
+#if defined(__linux__)
+    if (m_mapped)
+        munmap(m_data, m_bytes);
+    else
+#endif
+        alignedFree(m_data);
+    m_data = m_origin = nullptr;
+    m_bytes = 0;
+    m_mapped = false;
+}
+
+template <class T> void BasicPaddedGrid<T>::fill(T value) {
+    if (m_data)
+        std::fill(m_data, m_data + m_bytes / sizeof(T), value);
+}
+
+template <class T> void BasicPaddedGrid<T>::fillGhostsClamp() {
+    if (m_width <= 0 || m_height <= 0)
+        return;
+
+    for (int j = 0; j < m_height; ++j) {
+        T *r = row(j);
+        r[-1] = r[0];
+        r[m_width] = r[m_width - 1];
+    }
+    std::copy(row(0) - 1, row(0) + m_width + 1, row(-1) - 1);
+    std::copy(row(m_height - 1) - 1, row(m_height - 1) + m_width + 1, row(m_height) - 1);
+}
+
+template class BasicPaddedGrid<float>;
+template class BasicPaddedGrid<std::uint16_t>;
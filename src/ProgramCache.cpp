@@ -0,0 +1,96 @@
+#include <WaterSimulation/ProgramCache.h>
+
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/Optional.h>
+#include <Corrade/Containers/String.h>
+#include <Corrade/Containers/StringStl.h>
+#include <Corrade/Utility/Debug.h>
+#include <Corrade/Utility/Path.h>
+#include <Magnum/GL/Context.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+std::string &cacheDirectory() {
+    static std::string directory;
+    return directory;
+}
+
+void hashBytes(std::uint64_t &hash, Corrade::Containers::StringView bytes) {
+    for (char c : bytes) {
+        hash ^= std::uint8_t(c);
+        hash *= 0x100000001b3ull;
+    }
+    // séparateur : "ab" + "c" et "a" + "bc" ne donnent pas la même clé
+    hash ^= 0xff;
+    hash *= 0x100000001b3ull;
+}
+} // namespace
+
+void ProgramCache::setDirectory(std::string directory) {
+    if (!directory.empty() && !Corrade::Utility::Path::make(directory)) {
+        Corrade::Utility::Warning{} << "ProgramCache: cannot create" << directory.c_str() << ", cache disabled";
+        directory.clear();
+    }
+    cacheDirectory() = std::move(directory);
+}
+
+const std::string &ProgramCache::directory() { return cacheDirectory(); }
+
+std::uint64_t ProgramCache::key(std::initializer_list<Corrade::Containers::StringView> sources) {
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    const Magnum::GL::Context &context = Magnum::GL::Context::current();
+    hashBytes(hash, context.rendererString());
+    hashBytes(hash, context.versionString());
+    for (Corrade::Containers::StringView source : sources)
+        hashBytes(hash, source);
+    return hash;
+}
+
+std::string ProgramCache::path(std::uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return Corrade::Utility::Path::join(cacheDirectory(), name);
+}
+
+bool ProgramCache::load(Magnum::GL::AbstractShaderProgram &program, std::uint64_t key) {
+    if (cacheDirectory().empty())
+        return false;
+
+    const std::string file = path(key);
+    if (!Corrade::Utility::Path::exists(file))
+        return false;
+
+    // GLenum du format, puis le binaire
+    const Corrade::Containers::Optional<Corrade::Containers::Array<char>> data = Corrade::Utility::Path::read(file);
+    if (!data || data->size() <= sizeof(GLenum))
+        return false;
+
+    GLenum format;
+    std::memcpy(&format, data->data(), sizeof(GLenum));
+    glProgramBinary(program.id(), format, data->data() + sizeof(GLenum), GLsizei(data->size() - sizeof(GLenum)));
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program.id(), GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+void ProgramCache::store(Magnum::GL::AbstractShaderProgram &program, std::uint64_t key) {
+    if (cacheDirectory().empty())
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program.id(), GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) // pilote sans format binaire
+        return;
+
+    std::vector<char> data(sizeof(GLenum) + std::size_t(length));
+    GLenum format = 0;
+    glGetProgramBinary(program.id(), length, nullptr, &format, data.data() + sizeof(GLenum));
+    std::memcpy(data.data(), &format, sizeof(GLenum));
+
+    if (!Corrade::Utility::Path::write(path(key), Corrade::Containers::ArrayView<const void>{data.data(), data.size()}))
+        Corrade::Utility::Warning{} << "ProgramCache: cannot write" << path(key).c_str();
+}
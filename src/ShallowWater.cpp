@@ -1,12 +1,17 @@
 #include "Magnum/GL/Renderer.h"
 #include "Magnum/Trade/Trade.h"
+#include <Corrade/Containers/ArrayViewStl.h>
 #include <Corrade/Containers/StridedArrayView.h>
 #include <Corrade/Utility/Debug.h>
+#include <Magnum/GL/Context.h>
+#include <Magnum/GL/Extensions.h>
 #include <Magnum/GL/GL.h>
 #include <Magnum/GL/Renderer.h>
 #include <Magnum/Image.h>
 #include <Magnum/ImageView.h>
 #include <Magnum/Math/Color.h>
+#include <Magnum/Math/Constants.h>
+#include <Magnum/Math/Functions.h>
 #include <Magnum/PixelFormat.h>
 #include <Magnum/GL/ImageFormat.h>
 #include <WaterSimulation/ShallowWater.h>
@@ -15,361 +20,812 @@
 #include <cmath>
 #include <cstdint>
 #include <cstring>
+#include <utility>
 
 void ShallowWater::step() {
+    uploadParameters();
+    flushSources(dt);
+
+    const bool airyWaves = airyWavesEnabled && m_airySupported;
+    const Magnum::Vector2i size{nx + 1, ny + 1};
+
+    // le nouvel état est écrit dans la texture pong, échangée avec l'état à la fin du pas
+    const ComputeGraph::Resource state = m_graph.import(m_stateTexture);
+    const ComputeGraph::Resource stateOut = m_graph.import(m_stateTexturePong);
+    const ComputeGraph::Resource terrain = m_graph.import(m_terrainTexture);
+
+    // chemins sans ondes d'Airy : dispatch indirect sur les tuiles actives. Les ondes d'Airy restent sur toute la
+    // grille (FFT et multigrille globales, advection semi-lagrangienne qui lit au-delà de deux cellules)
+    const bool tiled = !airyWaves && activeTilesEnabled;
+    const int path = !tiled ? 0 : fusedStepEnabled ? 1 : 2;
+    if (path != m_activeTilesPath)
+        m_activeTilesWarmup = 2;
+    m_activeTilesPath = path;
+
+    if (tiled)
+        m_graph.addPass("active tiles", {state}, {}, [this] { runActiveTiles(); }, ComputeGraph::EndsWithBarrier);
+
+    if (!airyWaves && !fusedStepEnabled) {
+        if (tiled && !m_tileFluxTexture.id()) {
+            m_tileFluxTexture = Magnum::GL::Texture2D{};
+            m_tileFluxTexture.setStorage(1, stateTextureFormat(), size);
+        }
+        const ComputeGraph::Resource fluxes =
+            tiled ? m_graph.import(m_tileFluxTexture) : m_graph.transient(stateTextureFormat(), size);
+
+        m_graph.addPass("fluxes", {state, terrain}, {fluxes}, [&] {
+            if (!tiled) {
+                runSW(&m_stateTexture, &m_graph.texture(fluxes));
+                return;
+            }
+            m_updateFluxesTiledProgram.bindStates(&m_stateTexture, &m_graph.texture(fluxes))
+                .bindTerrain(&m_terrainTexture)
+                .runIndirect(m_activeTileBuffer);
+        });
+        m_graph.addPass("height", {fluxes}, {stateOut}, [&] {
+            ComputeProgram &program = tiled ? m_updateHeightSimpleTiledProgram : m_updateHeightSimpleProgram;
+            program.bindStates(&m_graph.texture(fluxes), &m_stateTexturePong);
+            if (tiled)
+                program.runIndirect(m_activeTileBuffer);
+            else
+                program.run(groupx, groupy);
+        });
+
+        m_graph.execute(m_profiler);
+        std::swap(m_stateTexture, m_stateTexturePong);
+        return;
+    }
 
-    if (!airyWavesEnabled) {
-        m_updateFluxesProgram.bindStates(&m_stateTexture, &m_tempTexture)
-            .bindTerrain(&m_terrainTexture)
-            .run(groupx, groupy);
-
-        Magnum::GL::Renderer::setMemoryBarrier(
-            Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
-
-        m_updateHeightSimpleProgram.bindStates(&m_tempTexture, &m_stateTexture)
-            .run(groupx, groupy);
-
-        Magnum::GL::Renderer::setMemoryBarrier(
-            Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
-            
-        ping = !ping;
+    if (!airyWaves) {
+        // flux et hauteur dans le même dispatch
+        m_graph.addPass("fluxes + height", {state, terrain}, {stateOut}, [&] {
+            ComputeProgram &program = tiled ? m_updateFluxesHeightTiledProgram : m_updateFluxesHeightProgram;
+            program.bindStates(&m_stateTexture, &m_stateTexturePong).bindTerrain(&m_terrainTexture);
+            if (tiled)
+                program.runIndirect(m_activeTileBuffer);
+            else
+                program.run(groupx, groupy);
+        });
+
+        m_graph.execute(m_profiler);
+        std::swap(m_stateTexture, m_stateTexturePong);
         return;
     }
 
-    m_CopyRGBAProgram.bindCopyRGBA(&m_stateTexture, &m_prevStateTexture).run(groupx, groupy);
-    Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+    // textures de la fenêtre de visualisation : seulement sur le pas demandé
+    const bool capture = m_captureNextStep;
+    m_captureNextStep = false;
+
+    auto addCapture = [&](ComputeGraph::Resource source, Magnum::GL::Texture2D &target, bool rgba) {
+        if (!capture)
+            return;
+        m_graph.addPass("capture", {source}, {m_graph.import(target)}, [this, source, &target, rgba] {
+            if (rgba)
+                m_CopyRGBAProgram.bindCopyRGBA(&m_graph.texture(source), &target).run(groupx, groupy);
+            else
+                m_copyProgram.bindCopy(&m_graph.texture(source), &target).run(groupx, groupy);
+        });
+    };
+
+    const ComputeGraph::Resource bulk = m_graph.import(m_bulkTexture);
+    const ComputeGraph::Resource surfaceHeight = m_graph.import(m_surfaceHeightTexture);
+    const ComputeGraph::Resource surfaceQx = m_graph.import(m_surfaceQxTexture);
+    const ComputeGraph::Resource surfaceQy = m_graph.import(m_surfaceQyTexture);
+
+    // ne vivent que pendant le pas : bulk après le pas d'eau peu profonde, surface transportée puis advectée
+    const ComputeGraph::Resource bulkUpdated = m_graph.transient(stateTextureFormat(), size);
+    const ComputeGraph::Resource transported = m_graph.transient(stateTextureFormat(), size);
+    const ComputeGraph::Resource advected = m_graph.transient(stateTextureFormat(), size);
 
     // Decompisition Bulk (shallow) + surface (airy) 
+    addDecompositionPasses(state);
 
-    runDecomposition(&m_stateTexture);
     // Shallow water pass
+    m_graph.addPass("shallow water", {bulk, terrain}, {bulkUpdated}, [&] {
+        runSW(&m_bulkTexture, &m_graph.texture(bulkUpdated));
+    });
+    addCapture(bulkUpdated, m_visBulkUpdated, true);
 
-    runSW(&m_bulkTexture, &m_tempTexture);
+    const float Nx = nx + 1;
+    const float Ny = ny + 1;
 
-    m_CopyRGBAProgram.bindCopyRGBA(&m_tempTexture, &m_visBulkUpdated).run(groupx, groupy);
-    Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
-
-    float N = nx+1;
-    Magnum::GL::Texture2D * fftHeight; Magnum::GL::Texture2D * ifftHeight;
-    Magnum::GL::Texture2D * fftQx; Magnum::GL::Texture2D * ifftQx;
-    Magnum::GL::Texture2D * fftQy; Magnum::GL::Texture2D * ifftQy;
     // Airy Waves
-    {   
-        
+    {
+        // demi-spectres de fftStockham.comp, ou les textures de surface elles-mêmes pour la FFT multi-passes
+        ComputeGraph::Resource spectrumHeight = surfaceHeight;
+        ComputeGraph::Resource spectrumQx = surfaceQx;
+        ComputeGraph::Resource spectrumQy = surfaceQy;
+        ComputeGraph::Resource pongHeight = 0, pongQx = 0, pongQy = 0;
+
         // FFT pass
-        fftHeight = runFFT(&m_surfaceHeightTexture, &m_surfaceHeightPong, 1);
-        
-        fftQx = runFFT(&m_surfaceQxTexture, &m_surfaceQxPong, 1);
-        fftQy = runFFT(&m_surfaceQyTexture, &m_surfaceQyPong, 1);
-
-        m_copyProgram.bindCopy(fftHeight, &m_visFFTHeight).run(groupx, groupy);
-        m_copyProgram.bindCopy(fftQx, &m_visFFTQx).run(groupx, groupy);
-        m_copyProgram.bindCopy(fftQy, &m_visFFTQy).run(groupx, groupy);
-        Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
-
-        m_airywavesProgram.bindAiry(&m_tempTexture, fftHeight, fftQx, fftQy)
-            .setFloatUniform("dt", dt)
-            .setFloatUniform("gravity", gravity)
-            .setFloatUniform("dx", dx)
-            .setFloatUniform("hBar", airyHBar)
-            .setIntUniform("N", static_cast<int>(N)).run(groupx, groupy);
+        if (m_stockhamFFT) {
+            const Magnum::Vector2i halfSize{(nx + 1) / 2 + 1, ny + 1};
+            spectrumHeight = m_graph.transient(Magnum::GL::TextureFormat::RG32F, halfSize);
+            spectrumQx = m_graph.transient(Magnum::GL::TextureFormat::RG32F, halfSize);
+            spectrumQy = m_graph.transient(Magnum::GL::TextureFormat::RG32F, halfSize);
+            addStockhamFFTPasses(1, 1.0f, spectrumQx, spectrumQy, spectrumHeight);
+        } else {
+            pongHeight = m_graph.transient(Magnum::GL::TextureFormat::RG32F, size);
+            pongQx = m_graph.transient(Magnum::GL::TextureFormat::RG32F, size);
+            pongQy = m_graph.transient(Magnum::GL::TextureFormat::RG32F, size);
+            addFFTPasses(1, {{surfaceHeight, pongHeight}, {surfaceQx, pongQx}, {surfaceQy, pongQy}});
+        }
 
-        Magnum::GL::Renderer::setMemoryBarrier(
-            Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+        addCapture(spectrumHeight, m_visFFTHeight, false);
+        addCapture(spectrumQx, m_visFFTQx, false);
+        addCapture(spectrumQy, m_visFFTQy, false);
+
+        m_graph.addPass("airy", {bulkUpdated, spectrumHeight, spectrumQx, spectrumQy}, {spectrumQx, spectrumQy},
+                        [&] {
+            m_airywavesProgram
+                .bindAiry(&m_graph.texture(bulkUpdated), &m_graph.texture(spectrumHeight),
+                          &m_graph.texture(spectrumQx), &m_graph.texture(spectrumQy))
+                .setVec2iUniform("N", {nx + 1, ny + 1})
+                .run(m_stockhamFFT ? (nx + 1) / 2 / 16 + 1 : groupx, groupy); // demi-spectre : Nx/2 + 1 colonnes
+        });
+
+        // Turn h, qx and qy back into spatial domain
+        if (m_stockhamFFT) {
+            addStockhamFFTPasses(-1, 1.0f / (Nx * Ny), spectrumQx, spectrumQy, spectrumHeight);
+        } else {
+            // Should just copy the original before fft instead of this
+            addFFTPasses(-1, {{surfaceQx, pongQx}, {surfaceQy, pongQy}, {surfaceHeight, pongHeight}});
+
+            // Normalize the IFFT outputs
+            for (ComputeGraph::Resource channel : {surfaceQx, surfaceQy, surfaceHeight})
+                m_graph.addPass("ifft", {channel}, {channel}, [this, channel, Nx, Ny] {
+                    m_normalizedProgram.bindReadWrite(&m_graph.texture(channel), Magnum::GL::ImageFormat::RG32F)
+                        .setFloatUniform("norm", 1.0f / (Nx * Ny))
+                        .run(groupx, groupy);
+                });
+        }
 
-        // Turn qx and qy back into spatial domain
-        ifftQx = runFFT(fftQx, &m_surfaceQxPong, -1);
-        ifftQy = runFFT(fftQy, &m_surfaceQyPong, -1);
+        addCapture(surfaceQx, m_visIFFTQx, false);
+        addCapture(surfaceQy, m_visIFFTQy, false);
+        addCapture(surfaceHeight, m_visIFFTHeight, false);
 
-        // Normalize the IFFT outputs
-        m_normalizedProgram.bindReadWrite(ifftQx, Magnum::GL::ImageFormat::RG32F)
-            .setFloatUniform("norm", 1.0f / (N * N))
-            .run(groupx, groupy);
+        m_fftOutput = &m_surfaceQxTexture;
+        m_ifftOutput = &m_surfaceQyTexture;
+    }
+
+    {//Surface Transportt
+        m_graph.addPass("transport", {surfaceQx, surfaceQy, bulkUpdated, bulk}, {transported}, [&] {
+            m_transportSurfaceFlowProgram
+                .bindTransportSurfaceFlow(&m_surfaceQxTexture, &m_surfaceQyTexture, &m_graph.texture(bulkUpdated),
+                                          &m_bulkTexture, &m_graph.texture(transported))
+                .run(groupx, groupy);
+        });
+        addCapture(transported, m_visTransportedFlow, true);
+
+        m_graph.addPass("transport", {surfaceHeight, bulk, transported}, {transported}, [&] {
+            m_transportSurfaceHeightProgram
+                .bindTransportSurfaceHeight(&m_surfaceHeightTexture, &m_bulkTexture, &m_graph.texture(transported))
+                .run(groupx, groupy);
+        });
+        addCapture(transported, m_visTransportedHeight, true);
+
+        m_graph.addPass("advection", {transported, bulkUpdated}, {advected}, [&] {
+            m_semiLagrangianAdvectionProgram
+                .bindAdvection(&m_graph.texture(transported), &m_graph.texture(advected),
+                               &m_graph.texture(bulkUpdated))
+                .run(groupx, groupy);
+        });
+        addCapture(advected, m_visAdvectedHeight, true);
+    }
 
-        m_normalizedProgram.bindReadWrite(ifftQy, Magnum::GL::ImageFormat::RG32F)
-            .setFloatUniform("norm", 1.0f / (N * N))
+    // l'état du début du pas est encore dans m_stateTexture, plus besoin de copie
+    m_graph.addPass("update height", {bulkUpdated, advected, state}, {stateOut}, [&] {
+        m_updateWaterHeightProgram
+            .bindUpdateHeight(&m_graph.texture(bulkUpdated), &m_graph.texture(advected), &m_stateTexture,
+                              &m_stateTexturePong)
             .run(groupx, groupy);
+    });
 
-        m_copyProgram.bindCopy(ifftQx, &m_visIFFTQx).run(groupx, groupy);
-        m_copyProgram.bindCopy(ifftQy, &m_visIFFTQy).run(groupx, groupy);
-        Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+    /* m_recomposeProgram.bindRecompose(&m_stateTexture, &m_tempTexture, &m_surfaceHeightTexture, 
+                                      &m_surfaceQxTexture, &m_surfaceQyTexture)
+        .run(groupx, groupy); */
 
-        m_fftOutput = ifftQx;
-        m_ifftOutput = ifftQy;
+    m_graph.execute(m_profiler);
+    std::swap(m_stateTexture, m_stateTexturePong);
+}
 
+void ShallowWater::setTimestep(float dt_) {
+    dt = dt_;
+    limitCFL = dx / (4.0f * dt);
+}
 
-        // IFFT pass, m_fftOutput can be surface Height pong, add an if 
-        ifftHeight = runFFT(fftHeight, &m_surfaceHeightPong, -1); // Should just copy the original before fft instead of this 
+void ShallowWater::dispatchMaxWaveSpeed() {
+    GpuProfiler::Scope profile{m_profiler, "cfl reduction"};
+    uploadParameters();
 
-        m_normalizedProgram.bindReadWrite(ifftHeight, Magnum::GL::ImageFormat::RG32F).setFloatUniform("norm", 1.0f/(N*N)).run(groupx, groupy);
+    const Magnum::UnsignedInt zero = 0;
+    m_waveSpeedBuffer.setData(Corrade::Containers::ArrayView<const Magnum::UnsignedInt>{&zero, 1},
+                              Magnum::GL::BufferUsage::DynamicRead);
 
-        m_copyProgram.bindCopy(ifftHeight, &m_visIFFTHeight).run(groupx, groupy);
-        Magnum::GL::Renderer::setMemoryBarrier(
-            Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_waveSpeedBuffer.id());
+    m_stateTexture.bindImage(0, 0, Magnum::GL::ImageAccess::ReadOnly, stateImageFormat());
 
-        Magnum::GL::Renderer::setMemoryBarrier(
-            Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
-    }
+    m_maxWaveSpeedProgram.run(groupx, groupy);
 
-    
-    {//Surface Transportt
+    Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::BufferUpdate);
+    m_waveSpeedPending = true;
+}
 
-        m_transportSurfaceFlowProgram.bindTransportSurfaceFlow(ifftQx, ifftQy, &m_tempTexture, &m_bulkTexture, &m_tempTexture2)
-            .setFloatUniform("dt", dt)
-            .setFloatUniform("dx", dx)
-            .setFloatUniform("transportGamma", transportGamma)
-            .run(groupx, groupy);
+float ShallowWater::readMaxWaveSpeed() {
+    Corrade::Containers::Array<char> data = m_waveSpeedBuffer.subData(0, sizeof(Magnum::UnsignedInt));
+    float speed;
+    std::memcpy(&speed, data.data(), sizeof(float));
+    m_waveSpeedPending = false;
+    return speed;
+}
 
-        Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
-        m_CopyRGBAProgram.bindCopyRGBA(&m_tempTexture2, &m_visTransportedFlow).run(groupx, groupy);
-        Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+double ShallowWater::totalVolume() {
+    const std::size_t groups = std::size_t(groupx) * std::size_t(groupy);
+    m_massBuffer.setData({nullptr, groups * sizeof(float)}, Magnum::GL::BufferUsage::DynamicRead);
 
-        m_transportSurfaceHeightProgram.bindTransportSurfaceHeight(ifftHeight, &m_bulkTexture, &m_tempTexture2)
-            .setFloatUniform("dt", dt)
-            .setFloatUniform("dx", dx)
-            .setFloatUniform("transportGamma", transportGamma)
-            .run(groupx, groupy);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_massBuffer.id());
+    m_stateTexture.bindImage(0, 0, Magnum::GL::ImageAccess::ReadOnly, stateImageFormat());
+    m_totalMassProgram.run(groupx, groupy);
 
-        Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
-        m_CopyRGBAProgram.bindCopyRGBA(&m_tempTexture2, &m_visTransportedHeight).run(groupx, groupy);
-        Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+    Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::BufferUpdate);
 
-        m_semiLagrangianAdvectionProgram.bindAdvection(&m_tempTexture2, &m_tempTexture3, &m_tempTexture)
-            .setFloatUniform("dt", dt)
-            .setFloatUniform("dx", dx)
-            .run(groupx, groupy);
+    Corrade::Containers::Array<char> data = m_massBuffer.subData(0, groups * sizeof(float));
+    const float *partialSums = reinterpret_cast<const float *>(data.data());
+    double volume = 0.0;
+    for (std::size_t i = 0; i < groups; ++i)
+        volume += partialSums[i];
+    return volume * dx * dx;
+}
 
-        Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
-        m_CopyRGBAProgram.bindCopyRGBA(&m_tempTexture3, &m_visAdvectedHeight).run(groupx, groupy);
-        Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+std::size_t ShallowWater::textureBytes(Magnum::GL::Texture2D &texture, Magnum::PixelFormat format) {
+    if (!texture.id())
+        return 0;
+    const Magnum::Vector2i size = texture.imageSize(0);
+    return std::size_t(size.product()) * Magnum::pixelFormatSize(format);
+}
 
-    }
+std::size_t ShallowWater::textureBytes(Magnum::GL::Texture2DArray &texture, Magnum::PixelFormat format) {
+    if (!texture.id())
+        return 0;
+    const Magnum::Vector3i size = texture.imageSize(0);
+    return std::size_t(size.product()) * Magnum::pixelFormatSize(format);
+}
 
-    m_updateWaterHeightProgram.bindUpdateHeight(&m_tempTexture, &m_tempTexture3, &m_prevStateTexture, &m_stateTexture)
-        .setFloatUniform("dt", dt)
-        .setFloatUniform("dx", dx)
-        .run(groupx, groupy);
-   
+std::size_t ShallowWater::bufferBytes(Magnum::GL::Buffer &buffer) {
+    return buffer.id() ? std::size_t(buffer.size()) : 0;
+}
 
-    
-    /* m_recomposeProgram.bindRecompose(&m_stateTexture, &m_tempTexture, &m_surfaceHeightTexture, 
-                                      &m_surfaceQxTexture, &m_surfaceQyTexture)
-        .run(groupx, groupy); */
+std::size_t ShallowWater::memoryUsage() {
+    const Magnum::PixelFormat state =
+        m_precision == StoragePrecision::Float16 ? Magnum::PixelFormat::RGBA16F : Magnum::PixelFormat::RGBA32F;
+
+    std::size_t bytes = m_graph.poolBytes();
+    for (Magnum::GL::Texture2D *texture : {&m_stateTexture, &m_stateTexturePong, &m_bulkTexture, &m_tileFluxTexture})
+        bytes += textureBytes(*texture, state);
+    bytes += textureBytes(m_terrainTexture, Magnum::PixelFormat::R32F);
+    for (Magnum::GL::Texture2D *texture : {&m_surfaceHeightTexture, &m_surfaceQxTexture, &m_surfaceQyTexture})
+        bytes += textureBytes(*texture, Magnum::PixelFormat::RG32F);
+    bytes += textureBytes(m_disturbanceDelta, Magnum::PixelFormat::R32I);
+    if (m_debugTexturesAllocated) {
+        for (Magnum::GL::Texture2D *texture : {&m_visBulkUpdated, &m_visTransportedFlow, &m_visTransportedHeight,
+                                               &m_visAdvectedHeight})
+            bytes += textureBytes(*texture, state);
+        for (Magnum::GL::Texture2D *texture : {&m_visFFTHeight, &m_visFFTQx, &m_visFFTQy, &m_visIFFTHeight,
+                                               &m_visIFFTQx, &m_visIFFTQy})
+            bytes += textureBytes(*texture, Magnum::PixelFormat::RG32F);
+    }
+    for (MultigridLevel &level : m_multigrid)
+        for (Magnum::GL::Texture2D *texture : {&level.u, &level.rhs, &level.coef})
+            bytes += textureBytes(*texture, Magnum::PixelFormat::RGBA32F);
+    for (Magnum::GL::Buffer *buffer :
+         {&m_activeTileBuffer, &m_tileWetBuffer, &m_disturbanceBuffer, &m_waveSpeedBuffer, &m_massBuffer,
+          &m_parameterBuffer, &m_multigridBuffer, &m_twiddleBuffer, &m_sourceBuffer, &m_sourceTileBuffer,
+          &m_sourceIndexBuffer})
+        bytes += bufferBytes(*buffer);
+    return bytes;
+}
 
-    Magnum::GL::Renderer::setMemoryBarrier(
-        Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+float ShallowWater::enforceCFL() {
+    // pas de mesure en attente (premier appel, état modifié depuis) : on la fait maintenant
+    if (!m_waveSpeedPending)
+        dispatchMaxWaveSpeed();
 
+    float speed = readMaxWaveSpeed();
+    if (speed <= 0.0f)
+        return maxDt;
+    return std::min(maxDt, cflNumber * dx / speed);
 }
 
-void ShallowWater::runDecomposition(Magnum::GL::Texture2D *inputTex) {
-    // Initialisation
-    m_decompositionProgram
-        .bindDecompose(inputTex, &m_terrainTexture, &m_bulkTexture,
-                       &m_surfaceHeightTexture, &m_surfaceQxTexture,
-                       &m_surfaceQyTexture, &m_tempTexture, &m_tempTexture2)
-        .setIntUniform("stage", 0)
-        .setFloatUniform("decompositionD", decompositionD)
-        .setFloatUniform("dryEps", dryEps)
-        .setFloatUniform("dx", dx)
-        .run(groupx, groupy);
+int ShallowWater::advanceTime(float simulatedTime) {
+    // commandes de la frame avant la mesure de vitesse : le pas adaptatif tient compte de l'eau ajoutée
+    flushSources(0.0f);
 
-    Magnum::GL::Renderer::setMemoryBarrier(
-        Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
-
-    Magnum::GL::Texture2D *tempIn = &m_tempTexture2;
-    Magnum::GL::Texture2D *tempOut = &m_tempTexture;
+    if (simulatedTime <= 0.0f) {
+        m_lastSubsteps = 0;
+        return 0;
+    }
 
-    for (int i = 0; i < diffusionIterations; i++) {
-        m_decompositionProgram
-            .bindDecompose(inputTex, &m_terrainTexture, &m_bulkTexture,
-                           &m_surfaceHeightTexture, &m_surfaceQxTexture,
-                           &m_surfaceQyTexture, tempIn, tempOut)
-            .setIntUniform("stage", 1)
-            .setFloatUniform("decompositionD", decompositionD)
-            .setFloatUniform("dryEps", dryEps)
-            .setFloatUniform("dx", dx)
-            .run(groupx, groupy);
+    if (!adaptiveTimestep) {
+        if (dt != maxDt)
+            setTimestep(maxDt);
 
-        Magnum::GL::Renderer::setMemoryBarrier(
-            Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+        m_lastSubsteps = static_cast<int>(std::lround(simulatedTime / dt));
+        for (int i = 0; i < m_lastSubsteps; ++i)
+            step();
+        return m_lastSubsteps;
+    }
 
-        std::swap(tempIn, tempOut);
+    float stable = enforceCFL();
+    int substeps = static_cast<int>(std::ceil(simulatedTime / stable));
+    float substep = simulatedTime / substeps;
+    if (substeps > maxSubsteps) {
+        substeps = maxSubsteps;
+        substep = stable;
     }
 
-    // Compute final values
-    m_decompositionProgram
-        .bindDecompose(inputTex, &m_terrainTexture, &m_bulkTexture,
-                       &m_surfaceHeightTexture, &m_surfaceQxTexture,
-                       &m_surfaceQyTexture, tempIn, tempOut)
-        .setIntUniform("stage", 2)
-        .setFloatUniform("decompositionD", decompositionD)
-        .setFloatUniform("dryEps", dryEps)
-        .setFloatUniform("dx", dx)
-        .run(groupx, groupy);
+    setTimestep(substep);
+    for (int i = 0; i < substeps; ++i)
+        step();
 
-    Magnum::GL::Renderer::setMemoryBarrier(
-        Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+    // mesure pour le prochain appel, relue une frame plus tard
+    dispatchMaxWaveSpeed();
+
+    m_lastSubsteps = substeps;
+    return substeps;
 }
 
-void ShallowWater::runSW(Magnum::GL::Texture2D *inputTex, Magnum::GL::Texture2D *outputTex) {
-    m_updateFluxesProgram.bindStates(inputTex, outputTex)
-        .bindTerrain(&m_terrainTexture)
-        .run(groupx, groupy);
+namespace {
+// étapes de diffusionMultigrid.comp
+enum MultigridStage { SetupFine = 0, SetupCoarse = 1, Smooth = 2, Restrict = 3, Prolong = 4, Check = 5 };
+
+constexpr int MultigridPreSmoothing = 1;   // balayages rouge-noir avant la restriction
+constexpr int MultigridPostSmoothing = 1;  // et après la prolongation
+constexpr int MultigridCoarsestSweeps = 8;
+constexpr int MultigridCoarsestSize = 8;
+} // namespace
+
+void ShallowWater::createMultigridLevels() {
+    Magnum::Vector2i size{nx + 1, ny + 1};
+    for (;;) {
+        m_multigrid.emplace_back();
+        MultigridLevel &level = m_multigrid.back();
+        level.size = size;
+        level.u.setStorage(1, Magnum::GL::TextureFormat::RGBA32F, size);
+        if (m_multigrid.size() > 1) { // niveau 0 : transitoires du graphe, voir multigridRhs
+            level.rhs.setStorage(1, Magnum::GL::TextureFormat::RGBA32F, size);
+            level.coef.setStorage(1, Magnum::GL::TextureFormat::RGBA32F, size);
+        }
 
-        Magnum::GL::Renderer::setMemoryBarrier(
-        Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+        if (size.max() <= MultigridCoarsestSize)
+            break;
+        size = (size + Magnum::Vector2i{1}) / 2;
+    }
 
+    const Magnum::UnsignedInt counters[4]{};
+    m_multigridBuffer.setData(counters, Magnum::GL::BufferUsage::DynamicRead);
 }
 
-Magnum::GL::Texture2D *ShallowWater::runFFT(Magnum::GL::Texture2D *pingTex,
-                                            Magnum::GL::Texture2D *pongTex,
-                                            int direction) {
-    int N = nx + 1;
-    int numStages = static_cast<int>(std::log2(N));
+void ShallowWater::runMultigridStage(int stage, Magnum::Vector2i size) {
+    m_diffusionMultigridProgram.setIntUniform("stage", stage)
+        .run((size.x() + 15) / 16, (size.y() + 15) / 16);
 
-    //Corrade::Utility::Debug{} << "N:" << N << " stages:" << numStages;
+    Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess |
+                                           Magnum::GL::Renderer::MemoryBarrier::ShaderStorage);
+}
 
-    bool pingIsInput = true;
-    unsigned int groupsX = (N + 256 - 1) / 256;
-    unsigned int groups16 = (N + 15) / 16;
+void ShallowWater::runVCycle(std::size_t l) {
+    MultigridLevel &level = m_multigrid[l];
+
+    // lissage et prolongation se font en place : u lié en lecture et en écriture
+    auto bindLevel = [&] {
+        level.u.bindImage(0, 0, Magnum::GL::ImageAccess::ReadOnly, Magnum::GL::ImageFormat::RGBA32F);
+        level.u.bindImage(1, 0, Magnum::GL::ImageAccess::WriteOnly, Magnum::GL::ImageFormat::RGBA32F);
+        multigridRhs(l).bindImage(2, 0, Magnum::GL::ImageAccess::ReadOnly, Magnum::GL::ImageFormat::RGBA32F);
+        multigridCoef(l).bindImage(3, 0, Magnum::GL::ImageAccess::ReadOnly, Magnum::GL::ImageFormat::RGBA32F);
+    };
+    // une couleur par dispatch, sur une demi-grille en x
+    auto smooth = [&](int sweeps) {
+        for (int i = 0; i < 2 * sweeps; ++i) {
+            m_diffusionMultigridProgram.setIntUniform("color", i % 2);
+            runMultigridStage(Smooth, {(level.size.x() + 1) / 2, level.size.y()});
+        }
+    };
 
-    // Bit reversal
-    m_bitReverseProgram.bindFFT(pingTex, pongTex)
-        .setIntUniform("u_length", N)
-        .setIntUniform("u_isVertical", 0)
-        .run(groups16, groups16);
+    bindLevel();
+    if (l + 1 == m_multigridDepth) {
+        smooth(MultigridCoarsestSweeps);
+        return;
+    }
 
-    Magnum::GL::Renderer::setMemoryBarrier(
-        Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+    smooth(MultigridPreSmoothing);
 
-    pingIsInput = false;
+    // résidu -> second membre du niveau grossier, mesuré sur la grille fine
+    MultigridLevel &coarse = m_multigrid[l + 1];
+    coarse.u.bindImage(1, 0, Magnum::GL::ImageAccess::WriteOnly, Magnum::GL::ImageFormat::RGBA32F);
+    coarse.rhs.bindImage(5, 0, Magnum::GL::ImageAccess::WriteOnly, Magnum::GL::ImageFormat::RGBA32F);
+    m_diffusionMultigridProgram.setIntUniform("measure", l == 0 ? 1 : 0);
+    runMultigridStage(Restrict, coarse.size);
+    if (l == 0)
+        runMultigridStage(Check, {1, 1});
 
-    //Corrade::Utility::Debug{} << "horizontal";
+    runVCycle(l + 1);
 
-    // Horizontal FFT stages
-    for(int s = 0; s < numStages; s++) {
-        Magnum::GL::Texture2D* in  = pingIsInput ? pingTex : pongTex;
-        Magnum::GL::Texture2D* out = pingIsInput ? pongTex : pingTex;
+    bindLevel();
+    coarse.u.bindImage(4, 0, Magnum::GL::ImageAccess::ReadOnly, Magnum::GL::ImageFormat::RGBA32F);
+    runMultigridStage(Prolong, level.size);
 
-        m_fftProgram.bindFFT(in, out)
-            .setIntUniform("u_stage", s)
-            .setIntUniform("u_length", N)
-            .setIntUniform("u_direction", direction)
-            .setIntUniform("u_isVertical", 0)
-            .run(groupsX, N);
+    smooth(MultigridPostSmoothing);
+}
 
-        Magnum::GL::Renderer::setMemoryBarrier(
-            Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+int ShallowWater::readDecompositionCycles(float &correction) {
+    Corrade::Containers::Array<char> data = m_multigridBuffer.subData(0, 4 * sizeof(Magnum::UnsignedInt));
+    const Magnum::UnsignedInt *counters = reinterpret_cast<const Magnum::UnsignedInt *>(data.data());
+    std::memcpy(&correction, &counters[3], sizeof(float));
+    return static_cast<int>(counters[2]);
+}
 
-        pingIsInput = !pingIsInput;
-    }
+void ShallowWater::addDecompositionPasses(ComputeGraph::Resource input) {
+    const Magnum::Vector2i size{nx + 1, ny + 1};
+    const ComputeGraph::Resource terrain = m_graph.import(m_terrainTexture);
+    const ComputeGraph::Resource bulk = m_graph.import(m_bulkTexture);
+    const ComputeGraph::Resource surfaceHeight = m_graph.import(m_surfaceHeightTexture);
+    const ComputeGraph::Resource surfaceQx = m_graph.import(m_surfaceQxTexture);
+    const ComputeGraph::Resource surfaceQy = m_graph.import(m_surfaceQyTexture);
+    const ComputeGraph::Resource fineU = m_graph.import(m_multigrid[0].u); // gardé d'un pas à l'autre (warmStart)
 
-    // Bit reversal
-    Magnum::GL::Texture2D* currentIn = pingIsInput ? pingTex : pongTex;
-    Magnum::GL::Texture2D* currentOut = pingIsInput ? pongTex : pingTex;
+    // (H, qx, qy, alpha) de stage 0, second membre et coefficients du niveau 0 : rien ne sert après la multigrille
+    const ComputeGraph::Resource smoothingInput = m_graph.transient(stateTextureFormat(), size);
+    const ComputeGraph::Resource fineRhs = m_graph.transient(Magnum::GL::TextureFormat::RGBA32F, size);
+    const ComputeGraph::Resource fineCoef = m_graph.transient(Magnum::GL::TextureFormat::RGBA32F, size);
 
-    m_bitReverseProgram.bindFFT(currentIn, currentOut)
-        .setIntUniform("u_length", N)
-        .setIntUniform("u_isVertical", 1)
-        .run(groups16, groups16);
+    // Initialisation
+    m_graph.addPass("decomposition", {input, terrain}, {smoothingInput}, [this, input, smoothingInput] {
+        m_decompositionProgram
+            .bindDecompose(&m_graph.texture(input), &m_terrainTexture, &m_bulkTexture,
+                           &m_surfaceHeightTexture, &m_surfaceQxTexture,
+                           &m_surfaceQyTexture, &m_multigrid[0].u, &m_graph.texture(smoothingInput))
+            .setIntUniform("stage", 0)
+            .run(groupx, groupy);
+    });
+
+    m_graph.addPass(
+        "multigrid", {smoothingInput, fineU}, {fineU, fineRhs, fineCoef},
+        [this, smoothingInput, fineRhs, fineCoef] {
+            runMultigrid(&m_graph.texture(smoothingInput), &m_graph.texture(fineRhs), &m_graph.texture(fineCoef));
+        },
+        ComputeGraph::EndsWithBarrier);
+
+    // Compute final values (stage 2 n'écrit pas tempOut)
+    m_graph.addPass("decomposition", {input, terrain, fineU}, {bulk, surfaceHeight, surfaceQx, surfaceQy},
+                    [this, input] {
+        m_decompositionProgram
+            .bindDecompose(&m_graph.texture(input), &m_terrainTexture, &m_bulkTexture,
+                           &m_surfaceHeightTexture, &m_surfaceQxTexture,
+                           &m_surfaceQyTexture, &m_multigrid[0].u, &m_bulkTexture)
+            .setIntUniform("stage", 2)
+            .run(groupx, groupy);
+    });
+}
 
-    Magnum::GL::Renderer::setMemoryBarrier(
-        Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+void ShallowWater::runMultigrid(Magnum::GL::Texture2D *source, Magnum::GL::Texture2D *fineRhs,
+                                Magnum::GL::Texture2D *fineCoef) {
+    MultigridLevel &fine = m_multigrid[0];
+    m_fineRhs = fineRhs;
+    m_fineCoef = fineCoef;
+
+    // Diffusion : pas implicite équivalent aux diffusionIterations pas explicites, résolu par V-cycles.
+    // L'arrêt sur tolérance se fait dans le shader, les cycles restants ne font rien : pas de lecture ici
+    const Magnum::UnsignedInt counters[4]{};
+    m_multigridBuffer.setData(counters, Magnum::GL::BufferUsage::DynamicRead);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, m_multigridBuffer.id());
+
+    m_diffusionMultigridProgram.setIntUniform("warmStart", m_multigridWarm ? 1 : 0);
+
+    source->bindImage(7, 0, Magnum::GL::ImageAccess::ReadOnly, stateImageFormat());
+    fine.u.bindImage(1, 0, Magnum::GL::ImageAccess::WriteOnly, Magnum::GL::ImageFormat::RGBA32F);
+    multigridRhs(0).bindImage(5, 0, Magnum::GL::ImageAccess::WriteOnly, Magnum::GL::ImageFormat::RGBA32F);
+    multigridCoef(0).bindImage(6, 0, Magnum::GL::ImageAccess::WriteOnly, Magnum::GL::ImageFormat::RGBA32F);
+    runMultigridStage(SetupFine, fine.size);
+
+    // au niveau l les k sont divisés par 4^l et sigma ne change pas : dès que 4^l >= diffusionIterations la
+    // diagonale domine et quelques balayages suffisent, les niveaux plus grossiers n'apporteraient rien
+    m_multigridDepth = 1;
+    while (m_multigridDepth < m_multigrid.size() && (1 << 2 * (m_multigridDepth - 1)) < diffusionIterations)
+        ++m_multigridDepth;
+
+    for (std::size_t l = 1; l < m_multigridDepth; ++l) {
+        multigridCoef(l - 1).bindImage(3, 0, Magnum::GL::ImageAccess::ReadOnly, Magnum::GL::ImageFormat::RGBA32F);
+        multigridCoef(l).bindImage(6, 0, Magnum::GL::ImageAccess::WriteOnly, Magnum::GL::ImageFormat::RGBA32F);
+        runMultigridStage(SetupCoarse, m_multigrid[l].size);
+    }
 
-    pingIsInput = !pingIsInput;
+    for (int cycle = 0; cycle < maxDecompositionCycles; ++cycle)
+        runVCycle(0);
 
-    //Corrade::Utility::Debug{} << "vertical";
+    m_multigridWarm = true;
+}
 
-    // Vertical fft
-    for(int s = 0; s < numStages; s++) {
-        Magnum::GL::Texture2D* in  = pingIsInput ? pingTex : pongTex;
-        Magnum::GL::Texture2D* out = pingIsInput ? pongTex : pingTex;
+void ShallowWater::runSW(Magnum::GL::Texture2D *inputTex, Magnum::GL::Texture2D *outputTex) {
+    m_updateFluxesProgram.bindStates(inputTex, outputTex)
+        .bindTerrain(&m_terrainTexture)
+        .run(groupx, groupy);
+}
 
-        m_fftProgram.bindFFT(in, out)
-            .setIntUniform("u_stage", s)
-            .setIntUniform("u_length", N)
-            .setIntUniform("u_direction", direction)
-            .setIntUniform("u_isVertical", 1)
-            .run(groupsX, N);
+void ShallowWater::runActiveTiles() {
+    // le compteur de tuiles est aussi le nombre de groupes en x du dispatch indirect
+    const Magnum::UnsignedInt dispatch[4]{0, 1, 1, 0};
+    m_activeTileBuffer.setSubData(0, Corrade::Containers::ArrayView<const Magnum::UnsignedInt>{dispatch, 4});
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, m_activeTileBuffer.id());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, m_tileWetBuffer.id());
+
+    m_stateTexture.bindImage(0, 0, Magnum::GL::ImageAccess::ReadOnly, stateImageFormat());
+    m_activeTilesProgram.setIntUniform("uForceActive", m_activeTilesWarmup > 0).run(groupx, groupy);
+    if (m_activeTilesWarmup > 0)
+        --m_activeTilesWarmup;
+
+    // liste lue par les dispatchs suivants, nombre de groupes par glDispatchComputeIndirect
+    Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess |
+                                           Magnum::GL::Renderer::MemoryBarrier::ShaderStorage |
+                                           Magnum::GL::Renderer::MemoryBarrier::Command);
+}
 
-        Magnum::GL::Renderer::setMemoryBarrier(
-            Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+int ShallowWater::lastActiveTileCount() {
+    if (m_activeTilesPath == 0)
+        return -1;
+    Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::BufferUpdate);
+    Corrade::Containers::Array<char> data = m_activeTileBuffer.subData(0, sizeof(Magnum::UnsignedInt));
+    Magnum::UnsignedInt count;
+    std::memcpy(&count, data.data(), sizeof(count));
+    return int(count);
+}
 
-        pingIsInput = !pingIsInput;
+void ShallowWater::addFFTPasses(
+    int direction, std::initializer_list<std::pair<ComputeGraph::Resource, ComputeGraph::Resource>> channels) {
+    // bit reversal, étages horizontaux, bit reversal, étages verticaux : un nombre pair d'allers-retours
+    const int stages = 2 * static_cast<int>(std::log2(nx + 1)) + 2;
+
+    for (int s = 0; s < stages; ++s) {
+        for (const auto &channel : channels) {
+            const ComputeGraph::Resource in = s % 2 == 0 ? channel.first : channel.second;
+            const ComputeGraph::Resource out = s % 2 == 0 ? channel.second : channel.first;
+            m_graph.addPass(direction == 1 ? "fft" : "ifft", {in}, {out}, [this, s, in, out, direction] {
+                runFFTStage(s, &m_graph.texture(in), &m_graph.texture(out), direction);
+            });
+        }
     }
-
-    return pingIsInput ? pingTex : pongTex;
 }
 
-void ShallowWater::compilePrograms() {
-    m_updateFluxesProgram = ComputeProgram("updateFluxes.comp");
-    m_updateWaterHeightProgram = ComputeProgram("updateWaterHeight.comp");
-    m_updateHeightSimpleProgram = ComputeProgram("updateHeightSimple.comp");
-    m_initProgram = ComputeProgram("init.comp");
-
-    m_decompositionProgram = ComputeProgram("decompose.comp");
+void ShallowWater::runFFTStage(int stage, Magnum::GL::Texture2D *input, Magnum::GL::Texture2D *output,
+                               int direction) {
+    int N = nx + 1;
+    int numStages = static_cast<int>(std::log2(N));
 
-    m_fftHorizontalProgram = ComputeProgram("CS_FFTHorizontal.comp");
-    m_fftVerticalProgram = ComputeProgram("CS_FFTVertical.comp");
+    unsigned int groupsX = (N + 256 - 1) / 256;
+    unsigned int groups16 = (N + 15) / 16;
 
-    m_fftProgram = ComputeProgram("fft.comp");
+    // Bit reversal
+    if (stage == 0 || stage == numStages + 1) {
+        m_bitReverseProgram.bindFFT(input, output)
+            .setIntUniform("u_length", N)
+            .setIntUniform("u_isVertical", stage == 0 ? 0 : 1)
+            .run(groups16, groups16);
+        return;
+    }
 
-    m_bitReverseProgram = ComputeProgram("bitreverse.comp");
+    const bool vertical = stage > numStages;
+    m_fftProgram.bindFFT(input, output)
+        .setIntUniform("u_stage", vertical ? stage - numStages - 2 : stage - 1)
+        .setIntUniform("u_length", N)
+        .setIntUniform("u_direction", direction)
+        .setIntUniform("u_isVertical", vertical ? 1 : 0)
+        .run(groupsX, N);
+}
 
-    m_normalizedProgram = ComputeProgram("normalize.comp");
+namespace {
+constexpr int StockhamMaxLength = 1024; // MAX_N de fftStockham.comp
+
+// longueurs que fftStockham.comp sait découper en étages radix 2, 3, 4 et 5
+bool isStockhamLength(int n) {
+    if (n < 1 || n > StockhamMaxLength)
+        return false;
+    for (int radix : {2, 3, 5})
+        while (n % radix == 0)
+            n /= radix;
+    return n == 1;
+}
 
-    m_debugAlphaProgram = ComputeProgram("debugAlpha.comp");
+void appendTwiddles(std::vector<Magnum::Vector2> &twiddles, int length) {
+    for (int k = 0; k < length; ++k) {
+        const double angle = -2.0 * Magnum::Constantsd::pi() * k / length;
+        twiddles.push_back({float(std::cos(angle)), float(std::sin(angle))});
+    }
+}
+} // namespace
+
+void ShallowWater::createSpectrum() {
+    const int Nx = nx + 1;
+    const int Ny = ny + 1;
+    // lignes réelles : FFT complexe de Nx/2 points, colonnes : Ny points
+    m_stockhamFFT = Nx % 2 == 0 && isStockhamLength(Nx / 2) && isStockhamLength(Ny);
+    if (!m_stockhamFFT) {
+        // FFT multi-passes radix 2 : grille carrée, N puissance de 2
+        m_airySupported = Nx == Ny && (Nx & (Nx - 1)) == 0;
+        if (!m_airySupported)
+            Corrade::Utility::Warning{} << "ShallowWater: no FFT for a" << Nx << "x" << Ny
+                                        << "grid (even width, sizes of the form 2^a 3^b 5^c), Airy waves disabled";
+        return;
+    }
 
-    m_copyProgram = ComputeProgram("copy.comp");
-    m_CopyRGBAProgram = ComputeProgram("copyRGBA.comp");
+    // table des lignes puis celle des colonnes
+    std::vector<Magnum::Vector2> twiddles;
+    twiddles.reserve(Nx + Ny);
+    appendTwiddles(twiddles, Nx);
+    appendTwiddles(twiddles, Ny);
+    m_twiddleBuffer.setData(twiddles, Magnum::GL::BufferUsage::StaticDraw);
+}
 
-    m_clearProgram = ComputeProgram("clear.comp");
-    m_clearRGProgram = ComputeProgram("clearRG.comp");
+namespace {
+// passes de fftStockham.comp
+enum StockhamPass { StockhamRowsForward = 0, StockhamColumns = 1, StockhamRowsInverse = 2 };
+} // namespace
+
+void ShallowWater::addStockhamFFTPasses(int direction, float norm, ComputeGraph::Resource spectrumQx,
+                                        ComputeGraph::Resource spectrumQy, ComputeGraph::Resource spectrumHeight) {
+    const ComputeGraph::Resource surfaceQx = m_graph.import(m_surfaceQxTexture);
+    const ComputeGraph::Resource surfaceQy = m_graph.import(m_surfaceQyTexture);
+    const ComputeGraph::Resource surfaceHeight = m_graph.import(m_surfaceHeightTexture);
+
+    // la normalisation sur la seconde passe
+    auto pass = [&](int stockhamPass, float passNorm) {
+        return [this, stockhamPass, direction, passNorm, spectrumQx, spectrumQy, spectrumHeight] {
+            runStockhamPass(stockhamPass, direction, passNorm, &m_graph.texture(spectrumQx),
+                            &m_graph.texture(spectrumQy), &m_graph.texture(spectrumHeight));
+        };
+    };
+
+    if (direction == 1) {
+        m_graph.addPass("fft", {surfaceQx, surfaceQy, surfaceHeight}, {spectrumQx, spectrumQy, spectrumHeight},
+                        pass(StockhamRowsForward, 1.0f));
+        m_graph.addPass("fft", {spectrumQx, spectrumQy, spectrumHeight}, {spectrumQx, spectrumQy, spectrumHeight},
+                        pass(StockhamColumns, norm));
+    } else {
+        m_graph.addPass("ifft", {spectrumQx, spectrumQy}, {spectrumQx, spectrumQy}, pass(StockhamColumns, 1.0f));
+        m_graph.addPass("ifft", {spectrumQx, spectrumQy}, {surfaceQx, surfaceQy}, pass(StockhamRowsInverse, norm));
+    }
+}
 
-        m_debugAlphaProgram = ComputeProgram("debugAlpha.comp");
-        m_disturbanceProgram = ComputeProgram("disturbance.comp");
-    m_airywavesProgram = ComputeProgram("airywaves.comp");
+void ShallowWater::runStockhamPass(int pass, int direction, float norm, Magnum::GL::Texture2D *spectrumQx,
+                                   Magnum::GL::Texture2D *spectrumQy, Magnum::GL::Texture2D *spectrumHeight) {
+    const int Nx = nx + 1;
+    const int Ny = ny + 1;
+
+    // canaux dans l'ordre qx, qy, h : l'inverse ne traite que les deux premiers
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, m_twiddleBuffer.id());
+    m_surfaceQxTexture.bindImage(0, 0, Magnum::GL::ImageAccess::ReadWrite, Magnum::GL::ImageFormat::RG32F);
+    m_surfaceQyTexture.bindImage(1, 0, Magnum::GL::ImageAccess::ReadWrite, Magnum::GL::ImageFormat::RG32F);
+    m_surfaceHeightTexture.bindImage(2, 0, Magnum::GL::ImageAccess::ReadWrite, Magnum::GL::ImageFormat::RG32F);
+    spectrumQx->bindImage(3, 0, Magnum::GL::ImageAccess::ReadWrite, Magnum::GL::ImageFormat::RG32F);
+    spectrumQy->bindImage(4, 0, Magnum::GL::ImageAccess::ReadWrite, Magnum::GL::ImageFormat::RG32F);
+    spectrumHeight->bindImage(5, 0, Magnum::GL::ImageAccess::ReadWrite, Magnum::GL::ImageFormat::RG32F);
+
+    // un groupe par ligne ou par colonne du demi-spectre
+    m_fftStockhamProgram.setVec2iUniform("u_size", {Nx, Ny})
+        .setIntUniform("u_direction", direction)
+        .setIntUniform("u_channels", direction == 1 ? 3 : 2)
+        .setIntUniform("u_pass", pass)
+        .setFloatUniform("u_norm", norm)
+        .run(pass == StockhamColumns ? Nx / 2 + 1 : Ny, 1);
+}
 
-    m_recomposeProgram = ComputeProgram("recompose.comp");
+void ShallowWater::compilePrograms() {
+    struct Entry {
+        ComputeProgram *program;
+        const char *file;
+        bool activeTiles = false;
+    };
+    const Entry programs[]{
+        {&m_updateFluxesProgram, "updateFluxes.comp"},
+        {&m_updateWaterHeightProgram, "updateWaterHeight.comp"},
+        {&m_updateHeightSimpleProgram, "updateHeightSimple.comp"},
+        {&m_updateFluxesHeightProgram, "updateFluxesHeight.comp"},
+        {&m_initProgram, "init.comp"},
+
+        {&m_activeTilesProgram, "activeTiles.comp"},
+        {&m_updateFluxesTiledProgram, "updateFluxes.comp", true},
+        {&m_updateHeightSimpleTiledProgram, "updateHeightSimple.comp", true},
+        {&m_updateFluxesHeightTiledProgram, "updateFluxesHeight.comp", true},
+
+        {&m_decompositionProgram, "decompose.comp"},
+        {&m_diffusionMultigridProgram, "diffusionMultigrid.comp"},
+
+        {&m_fftHorizontalProgram, "CS_FFTHorizontal.comp"},
+        {&m_fftVerticalProgram, "CS_FFTVertical.comp"},
+        {&m_fftProgram, "fft.comp"},
+        {&m_fftStockhamProgram, "fftStockham.comp"},
+        {&m_bitReverseProgram, "bitreverse.comp"},
+        {&m_normalizedProgram, "normalize.comp"},
+
+        {&m_debugAlphaProgram, "debugAlpha.comp"},
+        {&m_disturbanceProgram, "disturbance.comp"},
+        {&m_disturbanceResolveProgram, "disturbanceResolve.comp"},
+
+        {&m_copyProgram, "copy.comp"},
+        {&m_CopyRGBAProgram, "copyRGBA.comp"},
+        {&m_clearProgram, "clear.comp"},
+        {&m_clearRGProgram, "clearRG.comp"},
+
+        {&m_airywavesProgram, "airywaves.comp"},
+        {&m_recomposeProgram, "recompose.comp"},
+        {&m_transportSurfaceFlowProgram, "transportSurfaceFlow.comp"},
+        {&m_transportSurfaceHeightProgram, "transportSurfaceHeight.comp"},
+        {&m_semiLagrangianAdvectionProgram, "advectSurface.comp"},
+
+        {&m_createWaterProgram, "createWater.comp"},
+
+        {&m_maxWaveSpeedProgram, "maxWaveSpeed.comp"},
+        {&m_totalMassProgram, "totalMass.comp"},
+    };
+
+    // tout est soumis avant la première attente : avec KHR_parallel_shader_compile les programmes se compilent en
+    // parallèle sur les threads du pilote, sinon chaque compilation bloque comme avant
+    if (Magnum::GL::Context::current().isExtensionSupported<Magnum::GL::Extensions::KHR::parallel_shader_compile>())
+        glMaxShaderCompilerThreadsKHR(0xffffffffu);
+
+    for (const Entry &entry : programs)
+        *entry.program = ComputeProgram(entry.file, m_precision, entry.activeTiles);
+    for (const Entry &entry : programs)
+        entry.program->finishLink();
+}
 
-    m_transportSurfaceFlowProgram = ComputeProgram("transportSurfaceFlow.comp");
+void ShallowWater::uploadParameters() {
+    static_assert(sizeof(Parameters) % 16 == 0, "Parameters doit correspondre au std140 de parameters.glsl");
 
-    m_transportSurfaceHeightProgram = ComputeProgram("transportSurfaceHeight.comp");
+    const Parameters parameters{dx, dt, gravity, dryEps, friction_coef,
+                                decompositionD, airyHBar, transportGamma,
+                                float(diffusionIterations), decompositionTolerance, {}};
 
-    m_semiLagrangianAdvectionProgram = ComputeProgram("advectSurface.comp");
+    // un slider de l'UI ou un nouveau dt : sinon le bloc sur le GPU est déjà bon
+    if (!m_parametersUploaded) {
+        m_parameterBuffer.setData(Corrade::Containers::ArrayView<const Parameters>{&parameters, 1},
+                                  Magnum::GL::BufferUsage::DynamicDraw);
+        m_parametersUploaded = true;
+    } else if (std::memcmp(&parameters, &m_uploadedParameters, sizeof(Parameters)) != 0) {
+        m_parameterBuffer.setSubData(0, Corrade::Containers::ArrayView<const Parameters>{&parameters, 1});
+    }
+    m_uploadedParameters = parameters;
 
-    m_createWaterProgram = ComputeProgram("createWater.comp");
+    glBindBufferBase(GL_UNIFORM_BUFFER, ParametersBinding, m_parameterBuffer.id());
+}
 
-    m_updateFluxesProgram.setParametersUniforms(*this);
-    m_updateWaterHeightProgram.setParametersUniforms(*this);
-    m_updateHeightSimpleProgram.setParametersUniforms(*this);
-    m_decompositionProgram.setParametersUniforms(*this);
+void ShallowWater::requestDebugCapture() {
+    if (!m_debugTexturesAllocated)
+        createDebugTextures();
+    m_captureNextStep = true;
+}
 
-    m_airywavesProgram.setParametersUniforms(*this);
-    m_recomposeProgram.setParametersUniforms(*this);
-    m_transportSurfaceFlowProgram.setParametersUniforms(*this);
-    m_transportSurfaceHeightProgram.setParametersUniforms(*this);
-    m_semiLagrangianAdvectionProgram.setParametersUniforms(*this);
+void ShallowWater::createDebugTextures() {
+    const Magnum::GL::TextureFormat stateFormat =
+        m_precision == StoragePrecision::Float16 ? Magnum::GL::TextureFormat::RGBA16F
+                                                 : Magnum::GL::TextureFormat::RGBA32F;
+
+    for (Magnum::GL::Texture2D *texture : {&m_visBulkUpdated, &m_visTransportedFlow, &m_visTransportedHeight,
+                                           &m_visAdvectedHeight})
+        texture->setStorage(1, stateFormat, {nx + 1, ny + 1})
+            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
+            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
+
+    for (Magnum::GL::Texture2D *texture : {&m_visFFTHeight, &m_visFFTQx, &m_visFFTQy, &m_visIFFTHeight,
+                                           &m_visIFFTQx, &m_visIFFTQy})
+        texture->setStorage(1, Magnum::GL::TextureFormat::RG32F, {nx + 1, ny + 1})
+            .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
+            .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
+
+    m_debugTexturesAllocated = true;
+    clearDebugTextures();
+    Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
 }
 
-void ShallowWater::clearAllTextures() {
-    m_clearProgram.bindClear(&m_stateTexture).run(groupx, groupy);
-    m_clearProgram.bindClear(&m_stateTexturePong).run(groupx, groupy);
-    m_clearProgram.bindClear(&m_prevStateTexture).run(groupx, groupy);
-    m_clearProgram.bindClear(&m_bulkTexture).run(groupx, groupy);
-    m_clearProgram.bindClear(&m_surfaceTexture).run(groupx, groupy);
-    m_clearProgram.bindClear(&m_tempTexture).run(groupx, groupy);
-    m_clearProgram.bindClear(&m_tempTexture2).run(groupx, groupy);
-    m_clearProgram.bindClear(&m_tempTexture3).run(groupx, groupy);
-    
-    m_clearRGProgram.bindClear(&m_surfaceHeightTexture, Magnum::GL::ImageFormat::RG32F).run(groupx, groupy);
-    m_clearRGProgram.bindClear(&m_surfaceQxTexture, Magnum::GL::ImageFormat::RG32F).run(groupx, groupy);
-    m_clearRGProgram.bindClear(&m_surfaceQyTexture, Magnum::GL::ImageFormat::RG32F).run(groupx, groupy);
-    m_clearRGProgram.bindClear(&m_surfaceHeightPing, Magnum::GL::ImageFormat::RG32F).run(groupx, groupy);
-    m_clearRGProgram.bindClear(&m_surfaceHeightPong, Magnum::GL::ImageFormat::RG32F).run(groupx, groupy);
-    m_clearRGProgram.bindClear(&m_surfaceQxPong, Magnum::GL::ImageFormat::RG32F).run(groupx, groupy);
-    m_clearRGProgram.bindClear(&m_surfaceQyPong, Magnum::GL::ImageFormat::RG32F).run(groupx, groupy);
-    
+void ShallowWater::clearDebugTextures() {
     m_clearProgram.bindClear(&m_visBulkUpdated).run(groupx, groupy);
     m_clearRGProgram.bindClear(&m_visFFTHeight, Magnum::GL::ImageFormat::RG32F).run(groupx, groupy);
     m_clearRGProgram.bindClear(&m_visFFTQx, Magnum::GL::ImageFormat::RG32F).run(groupx, groupy);
@@ -380,9 +836,25 @@ void ShallowWater::clearAllTextures() {
     m_clearProgram.bindClear(&m_visTransportedFlow).run(groupx, groupy);
     m_clearProgram.bindClear(&m_visTransportedHeight).run(groupx, groupy);
     m_clearProgram.bindClear(&m_visAdvectedHeight).run(groupx, groupy);
+}
+
+void ShallowWater::clearAllTextures() {
+    m_clearProgram.bindClear(&m_stateTexture).run(groupx, groupy);
+    m_clearProgram.bindClear(&m_stateTexturePong).run(groupx, groupy);
+    m_clearProgram.bindClear(&m_bulkTexture).run(groupx, groupy);
+    
+    // les transitoires du graphe sont toujours écrites avant d'être lues, rien à effacer
+    m_clearRGProgram.bindClear(&m_surfaceHeightTexture, Magnum::GL::ImageFormat::RG32F).run(groupx, groupy);
+    m_clearRGProgram.bindClear(&m_surfaceQxTexture, Magnum::GL::ImageFormat::RG32F).run(groupx, groupy);
+    m_clearRGProgram.bindClear(&m_surfaceQyTexture, Magnum::GL::ImageFormat::RG32F).run(groupx, groupy);
+    
+    if (m_debugTexturesAllocated)
+        clearDebugTextures();
     
     m_fftOutput = nullptr;
     m_ifftOutput = nullptr;
+    m_multigridWarm = false;
+    m_activeTilesWarmup = 2; // textures d'état remises à zéro, alpha compris
     
     Magnum::GL::Renderer::setMemoryBarrier(
         Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
@@ -422,13 +894,13 @@ void ShallowWater::loadTerrainHeightMap(Magnum::Trade::ImageData2D *img,
 }
 
 void ShallowWater::initBump() {
-    ping = false;
+    m_waveSpeedPending = false;
     
     clearAllTextures();
 
+    uploadParameters();
     m_initProgram.bindStates(&m_stateTexture, &m_stateTexture)
         .bindTerrain(&m_terrainTexture)
-        .setFloatUniform("dryEps", dryEps)
         .setIntUniform("init_type", 0)
         .run(groupx, groupy);
 
@@ -437,13 +909,13 @@ void ShallowWater::initBump() {
 }
 
 void ShallowWater::initDamBreak() {
-    ping = false;
+    m_waveSpeedPending = false;
     
     clearAllTextures();
 
+    uploadParameters();
     m_initProgram.bindStates(&m_stateTexture, &m_stateTexture)
         .bindTerrain(&m_terrainTexture)
-        .setFloatUniform("dryEps", dryEps)
         .setIntUniform("init_type", 1)
         .run(groupx, groupy);
 
@@ -452,13 +924,13 @@ void ShallowWater::initDamBreak() {
 }
 
 void ShallowWater::initTsunami() {
-    ping = false;
+    m_waveSpeedPending = false;
     
     clearAllTextures();
 
+    uploadParameters();
     m_initProgram.bindStates(&m_stateTexture, &m_stateTexture)
         .bindTerrain(&m_terrainTexture)
-        .setFloatUniform("dryEps", dryEps)
         .setIntUniform("init_type", 3)
         .run(groupx, groupy);
 
@@ -470,6 +942,27 @@ void ShallowWater::applyDisturbances(const std::vector<Disturbance>& disturbance
     if (disturbances.empty())
         return;
 
+    GpuProfiler::Scope profile{m_profiler, "disturbances"};
+    const Magnum::Vector2i size{nx + 1, ny + 1};
+    if (!m_disturbanceDelta.id()) {
+        // alloué au premier appel, remis à zéro par chaque résolution ensuite
+        m_disturbanceDelta = Magnum::GL::Texture2D{};
+        m_disturbanceDelta.setStorage(1, Magnum::GL::TextureFormat::R32I, size);
+        Corrade::Containers::Array<char> zeros{Corrade::ValueInit, std::size_t(size.product()) * sizeof(Magnum::Int)};
+        m_disturbanceDelta.setSubImage(0, {}, Magnum::ImageView2D{Magnum::PixelFormat::R32I, size, zeros});
+    }
+
+    // rectangle touché par les empreintes 5 x 5
+    Magnum::Vector2i min = size, max{-1};
+    for (const Disturbance &d : disturbances) {
+        min = Magnum::Math::min(min, Magnum::Vector2i{d.px - 2, d.py - 2});
+        max = Magnum::Math::max(max, Magnum::Vector2i{d.px + 2, d.py + 2});
+    }
+    min = Magnum::Math::max(min, Magnum::Vector2i{0});
+    max = Magnum::Math::min(max, size - Magnum::Vector2i{1});
+    if (min.x() > max.x() || min.y() > max.y())
+        return; // toutes hors de la grille
+
     // Upload disturbances to GPU buffer
     m_disturbanceBuffer.setData(
         Corrade::Containers::ArrayView<const Disturbance>{disturbances.data(), disturbances.size()},
@@ -478,24 +971,33 @@ void ShallowWater::applyDisturbances(const std::vector<Disturbance>& disturbance
 
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_disturbanceBuffer.id());
 
-    m_stateTexture.bindImage(0, 0, Magnum::GL::ImageAccess::ReadWrite, Magnum::GL::ImageFormat::RGBA32F);
+    // un thread par point d'empreinte
+    const unsigned taps = unsigned(disturbances.size()) * 25u;
+    m_disturbanceDelta.bindImage(0, 0, Magnum::GL::ImageAccess::ReadWrite, Magnum::GL::ImageFormat::R32I);
+    m_disturbanceProgram.setIntUniform("uDisturbanceCount", int(disturbances.size()))
+        .setFloatUniform("uFixedPoint", DisturbanceFixedPoint)
+        .run((taps + 63u) / 64u, 1);
 
-    m_disturbanceProgram.setIntUniform("uDisturbanceCount", int(disturbances.size()));
+    Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
 
-    // Dispatch compute shader (one work group per disturbance)
-    m_disturbanceProgram.dispatchCompute({unsigned(disturbances.size()), 1, 1});
+    const Magnum::Vector2i extent = max - min + Magnum::Vector2i{1};
+    m_stateTexture.bindImage(0, 0, Magnum::GL::ImageAccess::ReadWrite, stateImageFormat());
+    m_disturbanceDelta.bindImage(1, 0, Magnum::GL::ImageAccess::ReadWrite, Magnum::GL::ImageFormat::R32I);
+    m_disturbanceResolveProgram.setVec2iUniform("uOrigin", min)
+        .setFloatUniform("uFixedPoint", DisturbanceFixedPoint)
+        .run((extent.x() + 15) / 16, (extent.y() + 15) / 16);
 
     // Memory barrier to ensure writes are seen by the gpu
     Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
 }
 void ShallowWater::initEmpty() {
-    ping = false;
+    m_waveSpeedPending = false;
     
     clearAllTextures();
 
+    uploadParameters();
     m_initProgram.bindStates(&m_stateTexture, &m_stateTexture)
         .bindTerrain(&m_terrainTexture)
-        .setFloatUniform("dryEps", dryEps)
         .setIntUniform("init_type", 4)
         .run(groupx, groupy);
 
@@ -504,34 +1006,130 @@ void ShallowWater::initEmpty() {
 }
 
 void ShallowWater::createWater(float x, float y, float radius, float quantity){
+    m_pendingSources.push_back({{x, y}, radius, quantity, DiscSource, 0, 0.0f, 0.0f});
+}
 
-    m_createWaterProgram.bindReadWrite(&m_stateTexture)
-        .bindTerrain(&m_terrainTexture)
-        .setFloatUniform("posx", x)
-        .setFloatUniform("posy", y)
-        .setFloatUniform("radius", radius)
-        .setFloatUniform("quantity", quantity)
-        .setIntUniform("mode", 0)
-        .run(groupx, groupy);
+void ShallowWater::sendWaveWall(int side, float width, float quantity){
+    m_pendingSources.push_back({{}, 0.0f, quantity, WallSource, side, width, 0.0f});
+}
 
-    Magnum::GL::Renderer::setMemoryBarrier(
-        Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+int ShallowWater::addInflow(float x, float y, float radius, std::vector<Magnum::Vector2> hydrograph) {
+    return addPersistentSource(InflowSource, x, y, radius, std::move(hydrograph));
+}
+
+int ShallowWater::addDrain(float x, float y, float radius, float rate) {
+    return addPersistentSource(DrainSource, x, y, radius, {{0.0f, rate}});
 }
 
+int ShallowWater::addPersistentSource(SourceKind kind, float x, float y, float radius,
+                                      std::vector<Magnum::Vector2> hydrograph) {
+    // au moins la cellule qui contient le centre
+    radius = std::max(radius, 0.75f);
 
+    int cells = 0;
+    for (int j = std::max(1, int(std::floor(y - radius))); j <= std::min(ny - 1, int(std::ceil(y + radius))); ++j)
+        for (int i = std::max(1, int(std::floor(x - radius))); i <= std::min(nx - 1, int(std::ceil(x + radius))); ++i)
+            if ((Magnum::Vector2{i + 0.5f, j + 0.5f} - Magnum::Vector2{x, y}).length() <= radius)
+                ++cells;
 
-void ShallowWater::sendWaveWall(int side, float width, float quantity){
-    m_createWaterProgram.bindReadWrite(&m_stateTexture)
-        .bindTerrain(&m_terrainTexture)
-        .setIntUniform("mode", 2)
-        .setIntUniform("wallSide", side)
-        .setFloatUniform("wallWidth", width)
-        .setFloatUniform("quantity", quantity)
-        .setFloatUniform("gravity", gravity)
-        .run(groupx, groupy);
+    m_persistentSources.push_back({m_nextSourceId, {x, y}, radius, kind, std::move(hydrograph), cells});
+    return m_nextSourceId++;
+}
 
-    Magnum::GL::Renderer::setMemoryBarrier(
-        Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+void ShallowWater::removeSource(int id) {
+    m_persistentSources.erase(std::remove_if(m_persistentSources.begin(), m_persistentSources.end(),
+                                             [id](const PersistentSource &source) { return source.id == id; }),
+                              m_persistentSources.end());
+}
+
+void ShallowWater::flushSources(float elapsed) {
+    if (!m_pendingSources.empty())
+        m_waveSpeedPending = false; // la mesure en attente ne voit pas la nouvelle eau
+
+    for (PersistentSource &source : m_persistentSources) {
+        // débit de l'hydrogramme à l'âge de la source, nul avant son premier point
+        const std::vector<Magnum::Vector2> &curve = source.hydrograph;
+        float rate = curve.empty() || source.age < curve.front().x() ? 0.0f : curve.back().y();
+        for (std::size_t k = 1; k < curve.size(); ++k) {
+            if (source.age >= curve[k - 1].x() && source.age < curve[k].x()) {
+                const float t = (source.age - curve[k - 1].x()) / (curve[k].x() - curve[k - 1].x());
+                rate = curve[k - 1].y() + t * (curve[k].y() - curve[k - 1].y());
+                break;
+            }
+        }
+        source.age += elapsed;
+
+        // volume du pas réparti sur les cellules du disque
+        const float depth = source.cells > 0 ? rate * elapsed / (source.cells * dx * dx) : 0.0f;
+        if (depth > 0.0f)
+            m_pendingSources.push_back({source.position, source.radius, depth, source.kind, 0, 0.0f, 0.0f});
+    }
+
+    if (m_pendingSources.empty())
+        return;
+
+    GpuProfiler::Scope profile{m_profiler, "sources"};
+    uploadParameters(); // gravity du mur de vague
+
+    // tuiles touchées par le rectangle de chaque commande, cellules de bord exclues comme dans createWater.comp
+    std::vector<std::pair<Magnum::UnsignedInt, Magnum::UnsignedInt>> binned; // (tuile, commande)
+    for (std::size_t c = 0; c < m_pendingSources.size(); ++c) {
+        const SourceCommand &command = m_pendingSources[c];
+        Magnum::Vector2i min{1}, max{nx - 1, ny - 1};
+        if (command.kind == WallSource) {
+            const int width = int(std::ceil(command.wallWidth));
+            if (command.wallSide == 0)
+                max.y() = width;
+            else if (command.wallSide == 1)
+                min.y() = ny - width;
+            else if (command.wallSide == 2)
+                max.x() = width;
+            else
+                min.x() = nx - width;
+        } else {
+            // centre de cellule (i + 0.5) à moins de radius
+            const Magnum::Vector2 &p = command.position;
+            min = Magnum::Math::max(min, Magnum::Vector2i{int(std::floor(p.x() - command.radius - 0.5f)),
+                                                          int(std::floor(p.y() - command.radius - 0.5f))});
+            max = Magnum::Math::min(max, Magnum::Vector2i{int(std::ceil(p.x() + command.radius - 0.5f)),
+                                                          int(std::ceil(p.y() + command.radius - 0.5f))});
+        }
+        min = Magnum::Math::max(min, Magnum::Vector2i{1});
+        max = Magnum::Math::min(max, Magnum::Vector2i{nx - 1, ny - 1});
+
+        for (int ty = min.y() / 16; ty <= max.y() / 16 && min.y() <= max.y(); ++ty)
+            for (int tx = min.x() / 16; tx <= max.x() / 16 && min.x() <= max.x(); ++tx)
+                binned.emplace_back(Magnum::UnsignedInt(ty * groupx + tx), Magnum::UnsignedInt(c));
+    }
+
+    // par tuile, commandes dans l'ordre de la file
+    std::stable_sort(binned.begin(), binned.end(),
+                     [](const auto &a, const auto &b) { return a.first < b.first; });
+    m_sourceTiles.clear();
+    m_sourceIndices.clear();
+    for (const auto &entry : binned) {
+        if (m_sourceTiles.empty() ||
+            m_sourceTiles.back().x() + m_sourceTiles.back().y() * Magnum::UnsignedInt(groupx) != entry.first)
+            m_sourceTiles.push_back({entry.first % Magnum::UnsignedInt(groupx), entry.first / Magnum::UnsignedInt(groupx),
+                                     Magnum::UnsignedInt(m_sourceIndices.size()), 0});
+        m_sourceIndices.push_back(entry.second);
+        ++m_sourceTiles.back().w();
+    }
+
+    if (!m_sourceTiles.empty()) {
+        m_sourceBuffer.setData(m_pendingSources, Magnum::GL::BufferUsage::DynamicDraw);
+        m_sourceTileBuffer.setData(m_sourceTiles, Magnum::GL::BufferUsage::DynamicDraw);
+        m_sourceIndexBuffer.setData(m_sourceIndices, Magnum::GL::BufferUsage::DynamicDraw);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, m_sourceBuffer.id());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, m_sourceTileBuffer.id());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, m_sourceIndexBuffer.id());
+
+        m_createWaterProgram.bindReadWrite(&m_stateTexture).run(unsigned(m_sourceTiles.size()), 1);
+
+        Magnum::GL::Renderer::setMemoryBarrier(
+            Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+    }
+    m_pendingSources.clear();
 }
 
 
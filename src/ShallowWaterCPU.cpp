@@ -4,356 +4,459 @@
 #include <Magnum/ImageView.h>
 #include <Magnum/Math/Color.h>
 #include <Magnum/PixelFormat.h>
-#include <WaterSimulation/ShallowWater.h>
+#include <WaterSimulation/ShallowWaterCPU.h>
 #include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstdint>
+#include <mutex>
 
-//get h at face ij with upwinding and hydrostatic reconstruction
-float ShallowWater::upwinded_h_x(int i, int j, float qxij) {
+bool ShallowWaterCPU::isWetFaceX(int i, int j) const {
     int il = std::max(0, i - 1);
     int ir = std::min(nx - 1, i);
     
-    float eta_l = h[idc(il, j)] + terrain[idc(il, j)];
-    float eta_r = h[idc(ir, j)] + terrain[idc(ir, j)];
-
-    float terrain_max = std::max(terrain[idc(il, j)], terrain[idc(ir, j)]);
-    float h_l_recon = std::max(0.0f, eta_l - terrain_max);
-    float h_r_recon = std::max(0.0f, eta_r - terrain_max);
-
-    //allow better flooding
-    if (std::abs(qxij) < dryEps) {
-        return std::max(h_l_recon, h_r_recon);
-    }
+    float etaL = h.at(il, j) + terrain.at(il, j);
+    float etaR = h.at(ir, j) + terrain.at(ir, j);
+    float zmax = std::max(terrain.at(il, j), terrain.at(ir, j));
+    return (etaL > zmax + dryEps) || (etaR > zmax + dryEps);
 
-    return (qxij >= 0.0f) ? h_l_recon : h_r_recon;
 }
 
-float ShallowWater::upwinded_h_y(int i, int j, float qyij) {
+bool ShallowWaterCPU::isWetFaceY(int i, int j) const {
     int jl = std::max(0, j - 1);
     int jr = std::min(ny - 1, j);
-    
-    float eta_b = h[idc(i, jl)] + terrain[idc(i, jl)];
-    float eta_t = h[idc(i, jr)] + terrain[idc(i, jr)];
-    
-    float terrain_max = std::max(terrain[idc(i, jl)], terrain[idc(i, jr)]);
-    float h_b_recon = std::max(0.0f, eta_b - terrain_max);
-    float h_t_recon = std::max(0.0f, eta_t - terrain_max);
 
-    if (std::abs(qyij) < dryEps) {
-        return std::max(h_b_recon, h_t_recon);
-    }
-    
-    return (qyij >= 0.0f) ? h_b_recon : h_t_recon;
+    float etaB = h.at(i, jl) + terrain.at(i, jl);
+    float etaT = h.at(i, jr) + terrain.at(i, jr);
+    float zmax = std::max(terrain.at(i, jl), terrain.at(i, jr));
+    return (etaB > zmax + dryEps) || (etaT > zmax + dryEps);
 }
 
-bool ShallowWater::isWetFaceX(int i, int j) const {
-    int il = std::max(0, i - 1);
-    int ir = std::min(nx - 1, i);
-    
-    float etaL = h[idc(il, j)] + terrain[idc(il, j)];
-    float etaR = h[idc(ir, j)] + terrain[idc(ir, j)];
-    float zmax = std::max(terrain[idc(il, j)], terrain[idc(ir, j)]);
-    return (etaL > zmax + dryEps) || (etaR > zmax + dryEps);
+void ShallowWaterCPU::setThreadCount(unsigned threads) {
+    if (threads == 1) {
+        pool.reset();
+        return;
+    }
+    pool = std::make_unique<ThreadPool>(threads);
+    if (pool->size() == 1)
+        pool.reset();
+}
 
+void ShallowWaterCPU::parallelRows(int begin, int end, const std::function<void(int, int)> &fn) {
+    if (pool)
+        pool->parallelFor(begin, end, fn);
+    else
+        fn(begin, end);
 }
 
-bool ShallowWater::isWetFaceY(int i, int j) const {
-    int jl = std::max(0, j - 1);
-    int jr = std::min(ny - 1, j);
+void ShallowWaterCPU::reserveBandScratch(std::size_t bandFloats) {
+    if (bandScratch.size() < threadCount() * bandFloats)
+        bandScratch.resize(threadCount() * bandFloats);
+}
 
-    float etaB = h[idc(i, jl)] + terrain[idc(i, jl)];
-    float etaT = h[idc(i, jr)] + terrain[idc(i, jr)];
-    float zmax = std::max(terrain[idc(i, jl)], terrain[idc(i, jr)]);
-    return (etaB > zmax + dryEps) || (etaT > zmax + dryEps);
+float *ShallowWaterCPU::bandScratchSlice(int begin, int end, int j0, std::size_t bandFloats) {
+    const unsigned band = pool ? pool->bandIndex(begin, end, j0) : 0;
+    return bandScratch.data() + band * bandFloats;
 }
 
-void ShallowWater::computeVelocities() {
+ShallowWaterKernels::Params ShallowWaterCPU::kernelParams() const {
+    return ShallowWaterKernels::Params{dx, dt, gravity, dryEps, friction_coef, limitCFL};
+}
 
-    for (int j = 0; j < ny; ++j) {
-        for (int i = 0; i < nx + 1; ++i) {
+void ShallowWaterCPU::setKernelIsa(ShallowWaterKernels::Isa isa) {
+    kernels = &ShallowWaterKernels::table(isa);
+}
 
-            float qxij = qx[idsx(i, j)];
-            float h_upwind = upwinded_h_x(i, j, qxij);
+void ShallowWaterCPU::computeVelocities() {
+    const ShallowWaterKernels::Params p = kernelParams();
 
-            if (h_upwind > dryEps) {
-                ux[idsx(i, j)] = qxij / h_upwind;
-            } else {
-                ux[idsx(i, j)] = 0.0f;
-                //qx[idsx(i, j)] = 0.0f;
-            }
+    // les ghosts de h et du terrain remplacent le clamp des indices sur les faces de bord
+    parallelRows(0, ny, [&](int j0, int j1) {
+        for (int j = j0; j < j1; ++j) {
+            // face i entre les cellules i-1 et i
+            kernels->velocity(p, h.row(j) - 1, terrain.row(j) - 1, h.row(j), terrain.row(j), qx.row(j), ux.row(j),
+                              0, nx + 1);
         }
-    }
-
-    for (int j = 0; j < ny + 1; ++j) {
-        for (int i = 0; i < nx; ++i) {
-
-            float qyij = qy[idsy(i, j)];
-            float h_upwind = upwinded_h_y(i, j, qyij);
+    });
 
-            if (h_upwind > dryEps) {
-                uy[idsy(i, j)] = qyij / h_upwind;
-            } else {
-                uy[idsy(i, j)] = 0.0f;
-                //qy[idsy(i, j)] = 0.0f;
-            }
+    parallelRows(0, ny + 1, [&](int j0, int j1) {
+        for (int j = j0; j < j1; ++j) {
+            kernels->velocity(p, h.row(j - 1), terrain.row(j - 1), h.row(j), terrain.row(j), qy.row(j), uy.row(j),
+                              0, nx);
         }
-    }
+    });
 }
 
-void ShallowWater::updateFluxes() {
-    std::vector<float> qx_new = qx;
-    std::vector<float> qy_new = qy;
-
-    for (int j = 1; j < ny - 1; ++j) {
-        for (int i = 1; i < nx; ++i) {
-            
-            if(!isWetFaceX(i, j)){
-                qx_new[idsx(i, j)] = 0.0f;
-                continue;
-            }
-
-            float qxij = qx[idsx(i, j)];
-            float h_upwind = upwinded_h_x(i, j, qxij);
-
-            if (h_upwind <= dryEps) {
-                qx_new[idsx(i, j)] = 0.0f;
-                continue;
-            }
-
-            float eta_l = h[idc(i-1, j)] + terrain[idc(i-1, j)];
-            float eta_r = h[idc(i, j)] + terrain[idc(i, j)];
-            
-            float h_avg = 0.5f * (h[idc(i-1, j)] + h[idc(i, j)]);
-
-            float pressure = -gravity * (eta_r - eta_l) / dx;
-
-            //advection
-            float qx_center = qxij;
-            float qx_left = qx[idsx(i-1, j)];
-            float qx_right = qx[idsx(i+1, j)];
-            
-            float u_face = qxij / h_upwind;
-            float advection = 0.0f;
-            
-            if (u_face > 0.0f) {
-                advection = -u_face * (qx_center - qx_left) / dx;
-            } else {
-                advection = -u_face * (qx_right - qx_center) / dx;
-            }
-
-            //
-
-            float friction = -friction_coef * u_face * std::abs(u_face) / h_upwind;
+void ShallowWaterCPU::updateFluxes() {
+    const ShallowWaterKernels::Params p = kernelParams();
 
-            float accel = pressure + friction;
-            
-            float dqdt = h_avg * accel + advection;
-
-            qx_new[idsx(i, j)] = qxij + dqdt * dt;
-            
-            float max_q = h_upwind * limitCFL;
-            qx_new[idsx(i, j)] = Magnum::Math::clamp(qx_new[idsx(i, j)], 
-                                                      -max_q, max_q);
+    // les faces non calculées ici (bords du domaine) restent à 0 dans les deux buffers, voir applyBarrier
+    parallelRows(1, ny - 1, [&](int j0, int j1) {
+        for (int j = j0; j < j1; ++j) {
+            kernels->fluxX(p, h.row(j), terrain.row(j), qx.row(j), qxNext.row(j), 1, nx);
         }
-    }
-
-    for (int j = 1; j < ny; ++j) {
-        for (int i = 1; i < nx - 1; ++i) {
-            
-            if(!isWetFaceY(i, j)){
-                qy_new[idsy(i, j)] = 0.0f;
-                continue;
-            }
-
-            float qyij = qy[idsy(i, j)];
-            float h_upwind = upwinded_h_y(i, j, qyij);
-
-            if (h_upwind <= dryEps) {
-                qy_new[idsy(i, j)] = 0.0f;
-                continue;
-            }
-
-            float eta_b = h[idc(i, j-1)] + terrain[idc(i, j-1)];
-            float eta_t = h[idc(i, j)] + terrain[idc(i, j)];
-            
-            float h_avg = 0.5f * (h[idc(i, j-1)] + h[idc(i, j)]);
-
-            float pressure = -gravity * (eta_t - eta_b) / dx;
-
-            //advection
-
-            float qy_center = qyij;
-            float qy_bottom = qy[idsy(i, j-1)];
-            float qy_top = qy[idsy(i, j+1)];
-            
-            float v_face = qyij / h_upwind;
-            float advection = 0.0f;
-            
-            if (v_face > 0.0f) {
-                advection = -v_face * (qy_center - qy_bottom) / dx;
-            } else {
-                advection = -v_face * (qy_top - qy_center) / dx;
-            }
-
-            //
-
-            float friction = -friction_coef * v_face * std::abs(v_face) / h_upwind;
-
-            float accel = pressure + friction;
-            float dqdt = h_avg * accel + advection;
+    });
 
-            qy_new[idsy(i, j)] = qyij + dqdt * dt;
-            
-            float max_q = h_upwind * limitCFL;
-            qy_new[idsy(i, j)] = Magnum::Math::clamp(qy_new[idsy(i, j)], 
-                                                      -max_q, max_q);
+    parallelRows(1, ny, [&](int j0, int j1) {
+        for (int j = j0; j < j1; ++j) {
+            kernels->fluxY(p, h.row(j - 1), terrain.row(j - 1), h.row(j), terrain.row(j), qy.row(j - 1), qy.row(j),
+                           qy.row(j + 1), qyNext.row(j), 1, nx - 1);
         }
-    }
+    });
 
-    qx = std::move(qx_new);
-    qy = std::move(qy_new);
+    qx.swap(qxNext);
+    qy.swap(qyNext);
 }
 
-void ShallowWater::applyBarrier() {
+void ShallowWaterCPU::applyBarrier() {
     for (int j = 0; j < ny; j++) {
-        qx[idsx(0, j)] = 0.0f;
-        ux[idsx(0, j)] = 0.0f;
-        qx[idsx(nx, j)] = 0.0f;
-        ux[idsx(nx, j)] = 0.0f;
+        qx.at(0, j) = 0.0f;
+        ux.at(0, j) = 0.0f;
+        qx.at(nx, j) = 0.0f;
+        ux.at(nx, j) = 0.0f;
     }
     
     for (int i = 0; i < nx; i++) {
-        qy[idsy(i, 0)] = 0.0f;
-        uy[idsy(i, 0)] = 0.0f;
-        qy[idsy(i, ny)] = 0.0f;
-        uy[idsy(i, ny)] = 0.0f;
+        qy.at(i, 0) = 0.0f;
+        uy.at(i, 0) = 0.0f;
+        qy.at(i, ny) = 0.0f;
+        uy.at(i, ny) = 0.0f;
     }
 }
 
-void ShallowWater::updateWaterHeight() {
+void ShallowWaterCPU::updateWaterHeight() {
+    const ShallowWaterKernels::Params p = kernelParams();
 
-    for (int j = 0; j < ny; ++j) {
-        for (int i = 0; i < nx; ++i) {
-
-			//if(isDry(i, j))
+    parallelRows(0, ny, [&](int j0, int j1) {
+        for (int j = j0; j < j1; ++j) {
+            kernels->height(p, h.row(j), qx.row(j), qy.row(j), qy.row(j + 1), 0, nx);
+        }
+    });
+}
 
-            float qxl = qx[idsx(i, j)];
-            float qxr = qx[idsx(i + 1, j)];
-            float qyb = qy[idsy(i, j)];
-            float qyt = qy[idsy(i, j + 1)];
+float ShallowWaterCPU::maxWaveSpeed() {
+    const std::size_t bandFloats = floatStateValid ? 0 : 4 * std::size_t(nx + 1);
+    reserveBandScratch(bandFloats);
+
+    std::mutex resultMutex;
+    float result = 0.0f;
+
+    parallelRows(0, ny, [&](int j0, int j1) {
+        float local = 0.0f;
+        float *buffer = bandScratchSlice(0, ny, j0, bandFloats);
+        for (int j = j0; j < j1; ++j) {
+            const float *rows[4];
+            stateRows(j, buffer, rows);
+            const float *hRow = rows[0];
+            const float *qxRow = rows[1];
+            const float *qyB = rows[2];
+            const float *qyT = rows[3];
+            for (int i = 0; i < nx; ++i) {
+                float hc = hRow[i];
+                if (hc <= dryEps)
+                    continue;
+
+                // vitesse la plus forte sur les 4 faces de la cellule
+                float q = std::max(std::max(std::abs(qxRow[i]), std::abs(qxRow[i + 1])),
+                                   std::max(std::abs(qyB[i]), std::abs(qyT[i])));
+                local = std::max(local, q / hc + std::sqrt(gravity * hc));
+            }
+        }
 
-            float div_x = (qxr - qxl) / dx;
-            float div_y = (qyt - qyb) / dx;
+        std::lock_guard<std::mutex> lock(resultMutex);
+        result = std::max(result, local);
+    });
 
-            float total_divergence = div_x + div_y;
+    return result;
+}
 
-            h[idc(i, j)] -= total_divergence * dt;
-            h[idc(i, j)] = std::max(0.0f, h[idc(i, j)]);
+double ShallowWaterCPU::totalVolume() {
+    const std::size_t bandFloats = floatStateValid ? 0 : 4 * std::size_t(nx + 1);
+    reserveBandScratch(bandFloats);
+
+    std::mutex resultMutex;
+    double result = 0.0;
+
+    parallelRows(0, ny, [&](int j0, int j1) {
+        double local = 0.0;
+        float *buffer = bandScratchSlice(0, ny, j0, bandFloats);
+        for (int j = j0; j < j1; ++j) {
+            const float *rows[4];
+            stateRows(j, buffer, rows);
+            for (int i = 0; i < nx; ++i)
+                local += rows[0][i];
         }
-    }
+
+        std::lock_guard<std::mutex> lock(resultMutex);
+        result += local;
+    });
+
+    return result * dx * dx;
 }
 
-void ShallowWater::enforceCFL(){
+float ShallowWaterCPU::enforceCFL(){
+    float speed = maxWaveSpeed();
+    if (speed <= 0.0f)
+        return maxDt;
+    return std::min(maxDt, cflNumber * dx / speed);
+}
 
+void ShallowWaterCPU::setTimestep(float dt_) {
+    dt = dt_;
+    limitCFL = dx / (5.0f * dt);
+}
 
+void ShallowWaterCPU::setAdaptiveTimestep(bool enabled, float cfl, float maxTimestep) {
+    adaptiveTimestep = enabled;
+    cflNumber = cfl;
+    if (maxTimestep > 0.0f)
+        maxDt = maxTimestep;
+    if (!enabled)
+        setTimestep(maxDt);
+}
+
+int ShallowWaterCPU::advanceTime(float simulatedTime) {
+    if (!adaptiveTimestep) {
+        int steps = static_cast<int>(std::lround(simulatedTime / dt));
+        advance(steps);
+        return steps;
+    }
 
+    int done = 0;
+    float remaining = simulatedTime;
+    while (remaining > 1e-6f * simulatedTime && done < maxSubsteps) {
+        // sous-pas égaux jusqu'à la fin de la frame, réévalués tous les stepsPerSweep pas
+        float stable = enforceCFL();
+        int needed = static_cast<int>(std::ceil(remaining / stable));
+        float substep = done + needed <= maxSubsteps ? remaining / needed : stable;
+        int count = std::min(std::max(1, stepsPerSweep), std::min(needed, maxSubsteps - done));
+
+        setTimestep(substep);
+        advance(count);
+        remaining -= count * substep;
+        done += count;
+    }
+    return done;
 }
 
-void ShallowWater::step() {
+void ShallowWaterCPU::step() {
+
+    if (isPacked()) {
+        advance(1);
+        return;
+    }
+
+    if (activeTilesEnabled) {
+        stepActiveTiles();
+        return;
+    }
+
+    h.fillGhostsClamp();
+    terrain.fillGhostsClamp();
 
     computeVelocities();
 	
     updateFluxes();
 	applyBarrier();
-	enforceCFL();
     updateWaterHeight();
 }
 
-// convertit h en tableau de pixels normalisé
-void ShallowWater::updateHeightTexture(Magnum::GL::Texture2D *texture) {
+std::size_t ShallowWaterCPU::memoryUsage() const {
+    std::size_t bytes = h.bytes() + qx.bytes() + qy.bytes() + qxNext.bytes() + qyNext.bytes() + terrain.bytes() +
+                        ux.bytes() + uy.bytes() + hNext.bytes();
+    bytes += hPacked.bytes() + qxPacked.bytes() + qyPacked.bytes() + hPackedNext.bytes() + qxPackedNext.bytes() +
+             qyPackedNext.bytes();
+    for (const TileScratch &scratch : tileScratch)
+        bytes += scratch.h.bytes() + scratch.terrain.bytes() + scratch.qx.bytes() + scratch.qy.bytes() +
+                 scratch.qxNext.bytes() + scratch.qyNext.bytes();
+    bytes += bandScratch.size() * sizeof(float);
+    return bytes + tileWet.size() + tileActive.size() + activeTiles.size() * sizeof(int);
+}
 
-    auto minmax = std::minmax_element(h.begin(), h.end());
-    auto minIt = minmax.first;
-    auto maxIt = minmax.second;
-    float minHeight = *minIt;
-    float maxHeight = *maxIt;
+// convertit h en tableau de pixels normalisé, écrit directement dans le pixel buffer de heightUploader
+void ShallowWaterCPU::updateHeightTexture(Magnum::GL::Texture2D *texture) {
+    // stockage réduit : chaque bande décode ses lignes, sans copie float de toute la grille
+    auto heightRow = [&](int j, float *buffer) -> const float * {
+        if (floatStateValid)
+            return h.row(j);
+        unpackRow(hPacked.row(j), buffer, nx);
+        return buffer;
+    };
+
+    // min / max par bande puis fusion, la normalisation a besoin des extrêmes de toute la frame
+    const std::size_t bandFloats = floatStateValid ? 0 : std::size_t(nx);
+    reserveBandScratch(bandFloats);
+
+    std::mutex resultMutex;
+    float minHeight = INFINITY;
+    float maxHeight = -INFINITY;
+    parallelRows(0, ny, [&](int j0, int j1) {
+        float localMin = INFINITY;
+        float localMax = -INFINITY;
+        float *buffer = bandScratchSlice(0, ny, j0, bandFloats);
+        const int n = nx;
+        for (int j = j0; j < j1; ++j) {
+            const float *row = heightRow(j, buffer);
+            for (int i = 0; i < n; ++i) {
+                localMin = std::min(localMin, row[i]);
+                localMax = std::max(localMax, row[i]);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(resultMutex);
+        minHeight = std::min(minHeight, localMin);
+        maxHeight = std::max(maxHeight, localMax);
+    });
 
     minh = minHeight;
     maxh = maxHeight;
 
-    std::vector<uint8_t> pixels;
-    pixels.resize(h.size());
-    std::transform(h.begin(), h.end(), pixels.begin(), [&](float height) {
-        float normalized = (height - minHeight) / (maxHeight - minHeight);
-        return static_cast<uint8_t>(
-            Magnum::Math::clamp(normalized * 255.0f, 0.0f, 255.0f));
+    uint8_t *pixels = heightUploader.map(Magnum::PixelFormat::R8Unorm, {nx, ny});
+    if (!pixels)
+        return;
+
+    parallelRows(0, ny, [&](int j0, int j1) {
+        float *buffer = bandScratchSlice(0, ny, j0, bandFloats);
+        // copies locales : out (uint8_t) peut aliaser les captures, elles seraient relues à chaque pixel
+        const int n = nx;
+        const float offset = minHeight;
+        const float range = maxHeight - minHeight;
+        for (int j = j0; j < j1; ++j) {
+            const float *row = heightRow(j, buffer);
+            uint8_t *out = pixels + std::size_t(j) * n;
+            for (int i = 0; i < n; ++i) {
+                float normalized = (row[i] - offset) / range;
+                out[i] = static_cast<uint8_t>(Magnum::Math::clamp(normalized * 255.0f, 0.0f, 255.0f));
+            }
+        }
     });
 
-    texture->setSubImage(0, {},
-                         Magnum::ImageView2D{Magnum::PixelFormat::R8Unorm,
-                                             {nx, ny},
-                                             {pixels.data(), pixels.size()}});
+    heightUploader.upload(*texture);
 }
 
 // convertit ux et uy  en tableau de pixels
-void ShallowWater::updateMomentumTexture(Magnum::GL::Texture2D *texture) {
-    float minUx = INFINITY, maxUx = -INFINITY;
-    float minUy = INFINITY, maxUy = -INFINITY;
-
-    for (int j = 0; j < ny; ++j) {
-        for (int i = 0; i < nx; ++i) {
-            float uxi = ux[idsx(i, j)];
-            float uyi = uy[idsy(i, j)];
-            minUx = std::min(minUx, uxi);
-            maxUx = std::max(maxUx, uxi);
-            minUy = std::min(minUy, uyi);
-            maxUy = std::max(maxUy, uyi);
+// sans normalisation, les extrêmes (debug) et les pixels sont calculés dans la même passe
+void ShallowWaterCPU::updateMomentumTexture(Magnum::GL::Texture2D *texture) {
+    // les balayages en stockage réduit ne calculent pas les vitesses : elles sont recalculées ligne par ligne depuis
+    // l'état décodé dans un buffer de la bande, sans copie float de toute la grille
+    const bool packed = isPacked();
+    const ShallowWaterKernels::Params p = kernelParams();
+    if (packed)
+        terrain.fillGhostsClamp();
+
+    // h de la ligne du dessous puis de la ligne courante avec un ghost de chaque côté, qx, qy, ux, uy
+    const int stride = nx + 2;
+    const std::size_t bandFloats = packed ? 6 * std::size_t(stride) : 0;
+    reserveBandScratch(bandFloats);
+    auto decodeRow = [&](const PaddedGrid &grid, const PackedGrid &packedGrid, int j, float *dst, int n) {
+        if (floatStateValid)
+            std::copy(grid.row(j), grid.row(j) + n, dst);
+        else
+            unpackRow(packedGrid.row(j), dst, n);
+    };
+    auto velocityRows = [&](int j, float *buffer, const float *&uxRow, const float *&uyRow) {
+        if (!packed) {
+            uxRow = ux.row(j);
+            uyRow = uy.row(j);
+            return;
         }
-    }
+        float *hBelow = buffer + 1;
+        float *hRow = buffer + stride + 1;
+        float *qxRow = buffer + 2 * stride;
+        float *qyRow = buffer + 3 * stride;
+        float *uxOut = buffer + 4 * stride;
+        float *uyOut = buffer + 5 * stride;
+        decodeRow(h, hPacked, std::max(j - 1, 0), hBelow, nx);
+        decodeRow(h, hPacked, j, hRow, nx);
+        decodeRow(qx, qxPacked, j, qxRow, nx + 1);
+        decodeRow(qy, qyPacked, j, qyRow, nx);
+        hBelow[-1] = hBelow[0];
+        hBelow[nx] = hBelow[nx - 1];
+        hRow[-1] = hRow[0];
+        hRow[nx] = hRow[nx - 1];
+
+        // mêmes faces que computeVelocities
+        kernels->velocity(p, hRow - 1, terrain.row(j) - 1, hRow, terrain.row(j), qxRow, uxOut, 0, nx + 1);
+        kernels->velocity(p, hBelow, terrain.row(j - 1), hRow, terrain.row(j), qyRow, uyOut, 0, nx);
+        uxRow = uxOut;
+        uyRow = uyOut;
+    };
 
-    minux = minUx;
-    maxux = maxUx;
-    minuy = minUy;
-    maxuy = maxUy;
     bool normalize = false;
 
-    std::vector<uint8_t> pixels;
-    pixels.resize(nx * ny * 3);
-
-    const float rangeUx = normalize ? (maxUx - minUx) : 1.0f;
-    const float rangeUy = normalize ? (maxUy - minUy) : 1.0f;
-    const float offsetUx = normalize ? minUx : 0.0f;
-    const float offsetUy = normalize ? minUy : 0.0f;
+    uint8_t *pixels = momentumUploader.map(Magnum::PixelFormat::RGB8Unorm, {nx, ny});
 
-    for (int j = 0; j < ny; ++j) {
-        for (int i = 0; i < nx; ++i) {
-            float uxi = ux[idsx(i, j)];
-            float uyi = uy[idsy(i, j)];
-
-            float normUx = (rangeUx > 0.0f) ? (uxi - offsetUx) / rangeUx : 0.0f;
-            float normUy = (rangeUy > 0.0f) ? (uyi - offsetUy) / rangeUy : 0.0f;
+    auto quantize = [&](int j, const float *uxRow, const float *uyRow, float offsetUx, float rangeUx, float offsetUy,
+                        float rangeUy) {
+        const int n = nx; // out (uint8_t) peut aliaser nx
+        uint8_t *out = pixels + std::size_t(j) * n * 3;
+        for (int i = 0; i < n; ++i) {
+            float normUx = (rangeUx > 0.0f) ? (uxRow[i] - offsetUx) / rangeUx : 0.0f;
+            float normUy = (rangeUy > 0.0f) ? (uyRow[i] - offsetUy) / rangeUy : 0.0f;
 
             normUx = Magnum::Math::clamp(normUx, 0.0f, 1.0f);
             normUy = Magnum::Math::clamp(normUy, 0.0f, 1.0f);
 
-            size_t idx = (j * nx + i) * 3;
-            pixels[idx + 0] = static_cast<uint8_t>(normUx * 255.0f);
-            pixels[idx + 1] = static_cast<uint8_t>(normUy * 255.0f);
-            pixels[idx + 2] = 0;
+            out[3 * i + 0] = static_cast<uint8_t>(normUx * 255.0f);
+            out[3 * i + 1] = static_cast<uint8_t>(normUy * 255.0f);
+            out[3 * i + 2] = 0;
         }
-    }
+    };
+
+    std::mutex resultMutex;
+    float minUx = INFINITY, maxUx = -INFINITY;
+    float minUy = INFINITY, maxUy = -INFINITY;
+
+    parallelRows(0, ny, [&](int j0, int j1) {
+        float localMinUx = INFINITY, localMaxUx = -INFINITY;
+        float localMinUy = INFINITY, localMaxUy = -INFINITY;
+        float *buffer = bandScratchSlice(0, ny, j0, bandFloats);
+        const int n = nx;
+        for (int j = j0; j < j1; ++j) {
+            const float *uxRow;
+            const float *uyRow;
+            velocityRows(j, buffer, uxRow, uyRow);
+            for (int i = 0; i < n; ++i) {
+                localMinUx = std::min(localMinUx, uxRow[i]);
+                localMaxUx = std::max(localMaxUx, uxRow[i]);
+                localMinUy = std::min(localMinUy, uyRow[i]);
+                localMaxUy = std::max(localMaxUy, uyRow[i]);
+            }
+            // la ligne est encore en cache
+            if (pixels && !normalize)
+                quantize(j, uxRow, uyRow, 0.0f, 1.0f, 0.0f, 1.0f);
+        }
+
+        std::lock_guard<std::mutex> lock(resultMutex);
+        minUx = std::min(minUx, localMinUx);
+        maxUx = std::max(maxUx, localMaxUx);
+        minUy = std::min(minUy, localMinUy);
+        maxUy = std::max(maxUy, localMaxUy);
+    });
+
+    minux = minUx;
+    maxux = maxUx;
+    minuy = minUy;
+    maxuy = maxUy;
+
+    if (!pixels)
+        return;
+
+    if (normalize)
+        parallelRows(0, ny, [&](int j0, int j1) {
+            float *buffer = bandScratchSlice(0, ny, j0, bandFloats);
+            for (int j = j0; j < j1; ++j) {
+                const float *uxRow;
+                const float *uyRow;
+                velocityRows(j, buffer, uxRow, uyRow);
+                quantize(j, uxRow, uyRow, minUx, maxUx - minUx, minUy, maxUy - minUy);
+            }
+        });
 
-    texture->setSubImage(
-        0, {},
-        Magnum::ImageView2D{
-            Magnum::PixelFormat::RGB8Unorm,
-            {nx, ny},
-            {pixels.data(), pixels.size()}});
+    momentumUploader.upload(*texture);
 }
 
-void ShallowWater::loadTerrainHeightMap(Magnum::Trade::ImageData2D* img, float scaling) {
+void ShallowWaterCPU::loadTerrainHeightMap(Magnum::Trade::ImageData2D* img, float scaling) {
 	const uint8_t* data = reinterpret_cast<const uint8_t*>(img->data().data());
 	const int channels = 4;
 
@@ -363,16 +466,19 @@ void ShallowWater::loadTerrainHeightMap(Magnum::Trade::ImageData2D* img, float s
 	for (int j = 0; j < ny; ++j) {
 		for (int i = 0; i < nx; ++i) {
 			const uint8_t r = data[(j * nx + i) * channels + 0];
-			terrain[idc(i, j)] = r * scaling / 255.0f;
-			minTerrain = std::min(minTerrain, terrain[idc(i, j)]);
-			maxTerrain = std::max(maxTerrain, terrain[idc(i, j)]);
+			terrain.at(i, j) = r * scaling / 255.0f;
+			minTerrain = std::min(minTerrain, terrain.at(i, j));
+			maxTerrain = std::max(maxTerrain, terrain.at(i, j));
 		}
 	}
 
 	Corrade::Utility::Debug{} << "Terrain height - min:" << minTerrain << "max:" << maxTerrain;
 }
 
-void ShallowWater::initBump() {
+void ShallowWaterCPU::initBump() {
+    unpackState();
+    floatStateModified = true;
+    activeTilesDirty = true;
     int centerX = nx / 2;
     int centerY = ny / 2;
     float bumpHeight = 2.0f;
@@ -383,28 +489,31 @@ void ShallowWater::initBump() {
             float distance = std::sqrt(static_cast<float>((i - centerX) * (i - centerX) +
                                                           (j - centerY) * (j - centerY)));
             float radius = 16.0f;
-            float totalHeight = baseLevel - terrain[idc(i, j)];
-            if (totalHeight <= dryEps) {h[idc(i, j)] = 0.0f; continue;}
-            h[idc(i, j)] = totalHeight;
+            float totalHeight = baseLevel - terrain.at(i, j);
+            if (totalHeight <= dryEps) {h.at(i, j) = 0.0f; continue;}
+            h.at(i, j) = totalHeight;
             if (distance < radius) {
-                h[idc(i, j)] += bumpHeight * (1.0f - distance / radius);
+                h.at(i, j) += bumpHeight * (1.0f - distance / radius);
             }
 
         }
     }
 }
 
-void ShallowWater::initTop() {
+void ShallowWaterCPU::initTop() {
+    unpackState();
+    floatStateModified = true;
+    activeTilesDirty = true;
     float waterLevel = 3.0f;
     int damPosition = ny / 6;
     
     for (int j = 0; j < ny; ++j) {
         for (int i = 0; i < nx; ++i) {
             if (j < damPosition) {
-                float depth = waterLevel - terrain[idc(i, j)];
-                h[idc(i, j)] = std::max(0.0f, depth);
+                float depth = waterLevel - terrain.at(i, j);
+                h.at(i, j) = std::max(0.0f, depth);
             } else {
-                h[idc(i, j)] = 0.0f;
+                h.at(i, j) = 0.0f;
             }
         }
     }
@@ -0,0 +1,137 @@
+#include <WaterSimulation/ShallowWaterCPU.h>
+
+#include <algorithm>
+
+// Tuiles actives du solveur CPU.
+// Une face dont les deux cellules ont h <= dryEps n'est jamais mouillée : son flux est 0 et la hauteur de ses
+// cellules ne bouge pas. Une tuile sans cellule mouillée et sans voisine mouillée peut donc être sautée, l'eau
+// n'avance que d'une cellule par pas et réactive la tuile avant de l'atteindre.
+// Les faces d'une tuile sont celles de ses cellules côté gauche / bas : qx [ax, bx) et qy [ay, by).
+
+void ShallowWaterCPU::setActiveTiles(bool enabled, int tileSize) {
+    activeTilesEnabled = enabled;
+    activeTileSize = std::max(1, tileSize);
+    activeTilesX = (nx + activeTileSize - 1) / activeTileSize;
+    activeTilesY = (ny + activeTileSize - 1) / activeTileSize;
+    tileWet.assign(activeTilesX * activeTilesY, 0);
+    tileActive.assign(activeTilesX * activeTilesY, 1);
+    activeTiles.clear();
+    activeTilesDirty = true;
+}
+
+void ShallowWaterCPU::clearTile(int tile) {
+    const int ax = (tile % activeTilesX) * activeTileSize;
+    const int ay = (tile / activeTilesX) * activeTileSize;
+    const int bx = std::min(nx, ax + activeTileSize);
+    const int by = std::min(ny, ay + activeTileSize);
+
+    for (int j = ay; j < by; ++j) {
+        std::fill(qx.row(j) + ax, qx.row(j) + bx, 0.0f);
+        std::fill(qxNext.row(j) + ax, qxNext.row(j) + bx, 0.0f);
+        std::fill(ux.row(j) + ax, ux.row(j) + bx, 0.0f);
+        std::fill(qy.row(j) + ax, qy.row(j) + bx, 0.0f);
+        std::fill(qyNext.row(j) + ax, qyNext.row(j) + bx, 0.0f);
+        std::fill(uy.row(j) + ax, uy.row(j) + bx, 0.0f);
+    }
+}
+
+void ShallowWaterCPU::updateActiveTiles(bool rescan) {
+    if (rescan) {
+        // tout est considéré actif, les tuiles sèches sont remises à 0 plus bas
+        std::fill(tileActive.begin(), tileActive.end(), 1);
+        parallelRows(0, activeTilesY, [&](int ty0, int ty1) {
+            for (int ty = ty0; ty < ty1; ++ty) {
+                for (int tx = 0; tx < activeTilesX; ++tx) {
+                    const int ax = tx * activeTileSize, bx = std::min(nx, ax + activeTileSize);
+                    const int ay = ty * activeTileSize, by = std::min(ny, ay + activeTileSize);
+                    bool wet = false;
+                    for (int j = ay; j < by && !wet; ++j)
+                        wet = std::any_of(h.row(j) + ax, h.row(j) + bx, [&](float v) { return v > dryEps; });
+                    tileWet[ty * activeTilesX + tx] = wet;
+                }
+            }
+        });
+        activeTilesDirty = false;
+    }
+
+    // dilatation d'une tuile, les tuiles qui sortent de la liste sont remises à 0
+    activeTiles.clear();
+    for (int ty = 0; ty < activeTilesY; ++ty) {
+        for (int tx = 0; tx < activeTilesX; ++tx) {
+            bool active = false;
+            for (int oy = std::max(0, ty - 1); oy <= std::min(activeTilesY - 1, ty + 1) && !active; ++oy)
+                for (int ox = std::max(0, tx - 1); ox <= std::min(activeTilesX - 1, tx + 1) && !active; ++ox)
+                    active = tileWet[oy * activeTilesX + ox];
+
+            const int tile = ty * activeTilesX + tx;
+            if (tileActive[tile] && !active)
+                clearTile(tile);
+            tileActive[tile] = active;
+            if (active)
+                activeTiles.push_back(tile);
+        }
+    }
+}
+
+void ShallowWaterCPU::stepActiveTiles() {
+    if (activeTilesX == 0)
+        setActiveTiles(true, activeTileSize);
+
+    h.fillGhostsClamp();
+    terrain.fillGhostsClamp();
+
+    if (activeTilesDirty)
+        updateActiveTiles(true);
+
+    const ShallowWaterKernels::Params p = kernelParams();
+    const int count = static_cast<int>(activeTiles.size());
+
+    auto forTiles = [&](auto &&fn) {
+        parallelRows(0, count, [&](int t0, int t1) {
+            for (int t = t0; t < t1; ++t) {
+                const int tile = activeTiles[t];
+                const int ax = (tile % activeTilesX) * activeTileSize;
+                const int ay = (tile / activeTilesX) * activeTileSize;
+                fn(tile, ax, std::min(nx, ax + activeTileSize), ay, std::min(ny, ay + activeTileSize));
+            }
+        });
+    };
+
+    // mêmes calculs que computeVelocities / updateFluxes / updateWaterHeight, restreints à chaque tuile
+    forTiles([&](int, int ax, int bx, int ay, int by) {
+        const int faceEnd = bx == nx ? nx + 1 : bx;
+        for (int j = ay; j < by; ++j)
+            kernels->velocity(p, h.row(j) - 1, terrain.row(j) - 1, h.row(j), terrain.row(j), qx.row(j), ux.row(j),
+                              ax, faceEnd);
+
+        const int rowEnd = by == ny ? ny + 1 : by;
+        for (int j = ay; j < rowEnd; ++j)
+            kernels->velocity(p, h.row(j - 1), terrain.row(j - 1), h.row(j), terrain.row(j), qy.row(j), uy.row(j),
+                              ax, bx);
+    });
+
+    forTiles([&](int, int ax, int bx, int ay, int by) {
+        for (int j = std::max(1, ay); j < std::min(ny - 1, by); ++j)
+            kernels->fluxX(p, h.row(j), terrain.row(j), qx.row(j), qxNext.row(j), std::max(1, ax), bx);
+
+        for (int j = std::max(1, ay); j < by; ++j)
+            kernels->fluxY(p, h.row(j - 1), terrain.row(j - 1), h.row(j), terrain.row(j), qy.row(j - 1), qy.row(j),
+                           qy.row(j + 1), qyNext.row(j), std::max(1, ax), std::min(nx - 1, bx));
+    });
+
+    qx.swap(qxNext);
+    qy.swap(qyNext);
+    applyBarrier();
+
+    forTiles([&](int tile, int ax, int bx, int ay, int by) {
+        bool wet = false;
+        for (int j = ay; j < by; ++j) {
+            kernels->height(p, h.row(j), qx.row(j), qy.row(j), qy.row(j + 1), ax, bx);
+            wet = wet || std::any_of(h.row(j) + ax, h.row(j) + bx, [&](float v) { return v > dryEps; });
+        }
+        tileWet[tile] = wet;
+    });
+
+    // les tuiles inactives n'ont pas bougé, leur état sec reste valable
+    updateActiveTiles(false);
+}
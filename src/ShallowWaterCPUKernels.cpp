@@ -0,0 +1,161 @@
+#include <WaterSimulation/ShallowWaterCPUKernels.h>
+
+#if defined(WATERSIM_CPU_X86)
+#include <emmintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+namespace ShallowWaterKernels {
+
+namespace {
+
+void scalarFluxX(const Params &p, const float *h, const float *terrain, const float *qx, float *qxNew, int i0,
+                 int i1) {
+    for (int i = i0; i < i1; ++i)
+        qxNew[i] = faceFlux(p, h[i - 1], terrain[i - 1], h[i], terrain[i], qx[i - 1], qx[i], qx[i + 1]);
+}
+
+void scalarFluxY(const Params &p, const float *hB, const float *terrainB, const float *hT, const float *terrainT,
+                 const float *qyB, const float *qyC, const float *qyT, float *qyNew, int i0, int i1) {
+    for (int i = i0; i < i1; ++i)
+        qyNew[i] = faceFlux(p, hB[i], terrainB[i], hT[i], terrainT[i], qyB[i], qyC[i], qyT[i]);
+}
+
+void scalarHeight(const Params &p, float *h, const float *qx, const float *qyB, const float *qyT, int i0, int i1) {
+    for (int i = i0; i < i1; ++i)
+        h[i] = cellHeight(p, h[i], qx[i], qx[i + 1], qyB[i], qyT[i]);
+}
+
+void scalarVelocity(const Params &p, const float *hA, const float *terrainA, const float *hB, const float *terrainB,
+                    const float *q, float *u, int i0, int i1) {
+    for (int i = i0; i < i1; ++i)
+        u[i] = faceVelocity(p, hA[i], terrainA[i], hB[i], terrainB[i], q[i]);
+}
+
+void scalarEnsembleFlux(const Params &p, const EnsembleParams &e, const float *hA, const float *terrainA,
+                        const float *hB, const float *terrainB, const float *qPrev, const float *q, const float *qNext,
+                        float *qNew, int n) {
+    for (int f = 0; f < n; ++f)
+        qNew[f] = faceFlux(memberParams(p, e, f % e.period), hA[f], terrainA[f], hB[f], terrainB[f], qPrev[f], q[f],
+                           qNext[f]);
+}
+
+void scalarEnsembleHeight(const Params &p, float *h, const float *qL, const float *qR, const float *qB,
+                          const float *qT, int n) {
+    for (int f = 0; f < n; ++f)
+        h[f] = cellHeight(p, h[f], qL[f], qR[f], qB[f], qT[f]);
+}
+
+void scalarPackHalf(const float *src, std::uint16_t *dst, int n) {
+    for (int i = 0; i < n; ++i)
+        dst[i] = floatToHalf(src[i]);
+}
+
+void scalarUnpackHalf(const std::uint16_t *src, float *dst, int n) {
+    for (int i = 0; i < n; ++i)
+        dst[i] = halfToFloat(src[i]);
+}
+
+void scalarPackBFloat16(const float *src, std::uint16_t *dst, int n) {
+    for (int i = 0; i < n; ++i)
+        dst[i] = floatToBFloat16(src[i]);
+}
+
+void scalarUnpackBFloat16(const std::uint16_t *src, float *dst, int n) {
+    for (int i = 0; i < n; ++i)
+        dst[i] = bfloat16ToFloat(src[i]);
+}
+
+#if defined(WATERSIM_CPU_X86)
+// SSE2 fait partie de la base x86-64, pas besoin de drapeaux de compilation dédiés
+struct SSE2 {
+    using Reg = __m128;
+    using Mask = __m128;
+    static constexpr int width = 4;
+
+    static Reg load(const float *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, Reg a) { _mm_storeu_ps(p, a); }
+    static Reg set1(float v) { return _mm_set1_ps(v); }
+    static Reg add(Reg a, Reg b) { return _mm_add_ps(a, b); }
+    static Reg sub(Reg a, Reg b) { return _mm_sub_ps(a, b); }
+    static Reg mul(Reg a, Reg b) { return _mm_mul_ps(a, b); }
+    static Reg div(Reg a, Reg b) { return _mm_div_ps(a, b); }
+    static Reg max(Reg a, Reg b) { return _mm_max_ps(a, b); }
+    static Reg min(Reg a, Reg b) { return _mm_min_ps(a, b); }
+    static Reg abs(Reg a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static Reg neg(Reg a) { return _mm_xor_ps(_mm_set1_ps(-0.0f), a); }
+    static Mask lt(Reg a, Reg b) { return _mm_cmplt_ps(a, b); }
+    static Mask le(Reg a, Reg b) { return _mm_cmple_ps(a, b); }
+    static Mask gt(Reg a, Reg b) { return _mm_cmpgt_ps(a, b); }
+    static Mask ge(Reg a, Reg b) { return _mm_cmpge_ps(a, b); }
+    static Mask orMask(Mask a, Mask b) { return _mm_or_ps(a, b); }
+    static Mask andMask(Mask a, Mask b) { return _mm_and_ps(a, b); }
+    static Reg select(Mask m, Reg a, Reg b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+    static Reg zeroIfNot(Mask m, Reg a) { return _mm_and_ps(m, a); }
+};
+
+bool cpuSupports(Isa isa) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    const bool f16c = (info[2] & (1 << 29)) != 0;
+    if (!osxsave || !avx)
+        return false;
+    const unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    if (isa == Isa::AVX2)
+        return (xcr0 & 0x6) == 0x6 && f16c && (info[1] & (1 << 5)) != 0;
+    if (isa == Isa::AVX512)
+        return (xcr0 & 0xe6) == 0xe6 && (info[1] & (1 << 16)) != 0;
+    return true;
+#else
+    // la table AVX2 utilise aussi F16C pour les conversions fp16
+    if (isa == Isa::AVX2)
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c");
+    if (isa == Isa::AVX512)
+        return __builtin_cpu_supports("avx512f");
+    return true;
+#endif
+}
+#endif
+
+} // namespace
+
+const Table &scalarTable() {
+    static const Table t{"scalar",           scalarFluxX,        scalarFluxY,          scalarHeight,
+                         scalarVelocity,     scalarPackHalf,     scalarUnpackHalf,     scalarPackBFloat16,
+                         scalarUnpackBFloat16, scalarEnsembleFlux, scalarEnsembleHeight};
+    return t;
+}
+
+#if defined(WATERSIM_CPU_X86)
+const Table &sse2Table() {
+    // pas de F16C ni de conversions 16 bits efficaces en SSE2 : conversions scalaires
+    static const Table t = SimdKernels<SSE2>::makeTable("sse2", scalarPackHalf, scalarUnpackHalf, scalarPackBFloat16,
+                                                        scalarUnpackBFloat16);
+    return t;
+}
+#endif
+
+const Table &table(Isa isa) {
+#if defined(WATERSIM_CPU_X86)
+    if ((isa == Isa::Best || isa == Isa::AVX512) && cpuSupports(Isa::AVX512))
+        return avx512Table();
+    if ((isa == Isa::Best || isa == Isa::AVX512 || isa == Isa::AVX2) && cpuSupports(Isa::AVX2))
+        return avx2Table();
+    if (isa != Isa::Scalar)
+        return sse2Table();
+#else
+    static_cast<void>(isa);
+#endif
+    return scalarTable();
+}
+
+} // namespace ShallowWaterKernels
@@ -0,0 +1,90 @@
+// Compilé avec -mavx2 -mf16c (/arch:AVX2), n'est appelé que si le processeur supporte AVX2 et F16C
+#include <WaterSimulation/ShallowWaterCPUKernels.h>
+
+#include <immintrin.h>
+
+namespace ShallowWaterKernels {
+
+namespace {
+
+struct AVX2 {
+    using Reg = __m256;
+    using Mask = __m256;
+    static constexpr int width = 8;
+
+    static Reg load(const float *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, Reg a) { _mm256_storeu_ps(p, a); }
+    static Reg set1(float v) { return _mm256_set1_ps(v); }
+    static Reg add(Reg a, Reg b) { return _mm256_add_ps(a, b); }
+    static Reg sub(Reg a, Reg b) { return _mm256_sub_ps(a, b); }
+    static Reg mul(Reg a, Reg b) { return _mm256_mul_ps(a, b); }
+    static Reg div(Reg a, Reg b) { return _mm256_div_ps(a, b); }
+    static Reg max(Reg a, Reg b) { return _mm256_max_ps(a, b); }
+    static Reg min(Reg a, Reg b) { return _mm256_min_ps(a, b); }
+    static Reg abs(Reg a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static Reg neg(Reg a) { return _mm256_xor_ps(_mm256_set1_ps(-0.0f), a); }
+    static Mask lt(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static Mask le(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static Mask gt(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static Mask ge(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static Mask orMask(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+    static Mask andMask(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+    static Reg select(Mask m, Reg a, Reg b) { return _mm256_blendv_ps(b, a, m); }
+    static Reg zeroIfNot(Mask m, Reg a) { return _mm256_and_ps(m, a); }
+};
+
+void packHalf(const float *src, std::uint16_t *dst, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                         _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+    for (; i < n; ++i)
+        dst[i] = floatToHalf(src[i]);
+}
+
+void unpackHalf(const std::uint16_t *src, float *dst, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i))));
+    for (; i < n; ++i)
+        dst[i] = halfToFloat(src[i]);
+}
+
+void packBFloat16(const float *src, std::uint16_t *dst, int n) {
+    const __m256i bias = _mm256_set1_epi32(0x7fff);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i quiet = _mm256_set1_epi32(0x40);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 v = _mm256_loadu_ps(src + i);
+        const __m256i x = _mm256_castps_si256(v);
+        const __m256i high = _mm256_srli_epi32(x, 16);
+        __m256i r = _mm256_srli_epi32(_mm256_add_epi32(x, _mm256_add_epi32(bias, _mm256_and_si256(high, one))), 16);
+        const __m256i nan = _mm256_castps_si256(_mm256_cmp_ps(v, v, _CMP_UNORD_Q));
+        r = _mm256_blendv_epi8(r, _mm256_or_si256(high, quiet), nan);
+        // packus travaille par moitié de 128 bits : on regroupe les deux quadruplets dans la moitié basse
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(r, r), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm256_castsi256_si128(packed));
+    }
+    for (; i < n; ++i)
+        dst[i] = floatToBFloat16(src[i]);
+}
+
+void unpackBFloat16(const std::uint16_t *src, float *dst, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i x = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_castsi256_ps(_mm256_slli_epi32(x, 16)));
+    }
+    for (; i < n; ++i)
+        dst[i] = bfloat16ToFloat(src[i]);
+}
+
+} // namespace
+
+const Table &avx2Table() {
+    static const Table t = SimdKernels<AVX2>::makeTable("avx2", packHalf, unpackHalf, packBFloat16, unpackBFloat16);
+    return t;
+}
+
+} // namespace ShallowWaterKernels
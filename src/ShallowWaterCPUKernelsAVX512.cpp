@@ -0,0 +1,94 @@
+// Compilé avec -mavx512f (/arch:AVX512), n'est appelé que si le processeur supporte AVX-512F
+#include <WaterSimulation/ShallowWaterCPUKernels.h>
+
+#include <immintrin.h>
+
+namespace ShallowWaterKernels {
+
+namespace {
+
+struct AVX512 {
+    using Reg = __m512;
+    using Mask = __mmask16;
+    static constexpr int width = 16;
+
+    static Reg load(const float *p) { return _mm512_loadu_ps(p); }
+    static void store(float *p, Reg a) { _mm512_storeu_ps(p, a); }
+    static Reg set1(float v) { return _mm512_set1_ps(v); }
+    static Reg add(Reg a, Reg b) { return _mm512_add_ps(a, b); }
+    static Reg sub(Reg a, Reg b) { return _mm512_sub_ps(a, b); }
+    static Reg mul(Reg a, Reg b) { return _mm512_mul_ps(a, b); }
+    static Reg div(Reg a, Reg b) { return _mm512_div_ps(a, b); }
+    // max/min AVX-512 ont la même sémantique que maxps/minps (second opérande si NaN ou égalité)
+    static Reg max(Reg a, Reg b) { return _mm512_max_ps(a, b); }
+    static Reg min(Reg a, Reg b) { return _mm512_min_ps(a, b); }
+    static Reg abs(Reg a) {
+        return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x7fffffff)));
+    }
+    static Reg neg(Reg a) {
+        return _mm512_castsi512_ps(
+            _mm512_xor_si512(_mm512_castps_si512(a), _mm512_set1_epi32(static_cast<int>(0x80000000u))));
+    }
+    static Mask lt(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static Mask le(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+    static Mask gt(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static Mask ge(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+    static Mask orMask(Mask a, Mask b) { return static_cast<Mask>(a | b); }
+    static Mask andMask(Mask a, Mask b) { return static_cast<Mask>(a & b); }
+    static Reg select(Mask m, Reg a, Reg b) { return _mm512_mask_blend_ps(m, b, a); }
+    static Reg zeroIfNot(Mask m, Reg a) { return _mm512_maskz_mov_ps(m, a); }
+};
+
+void packHalf(const float *src, std::uint16_t *dst, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                            _mm512_cvtps_ph(_mm512_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    for (; i < n; ++i)
+        dst[i] = floatToHalf(src[i]);
+}
+
+void unpackHalf(const std::uint16_t *src, float *dst, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+        _mm512_storeu_ps(dst + i, _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i))));
+    for (; i < n; ++i)
+        dst[i] = halfToFloat(src[i]);
+}
+
+void packBFloat16(const float *src, std::uint16_t *dst, int n) {
+    const __m512i bias = _mm512_set1_epi32(0x7fff);
+    const __m512i one = _mm512_set1_epi32(1);
+    const __m512i quiet = _mm512_set1_epi32(0x40);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m512 v = _mm512_loadu_ps(src + i);
+        const __m512i x = _mm512_castps_si512(v);
+        const __m512i high = _mm512_srli_epi32(x, 16);
+        __m512i r = _mm512_srli_epi32(_mm512_add_epi32(x, _mm512_add_epi32(bias, _mm512_and_si512(high, one))), 16);
+        r = _mm512_mask_or_epi32(r, _mm512_cmp_ps_mask(v, v, _CMP_UNORD_Q), high, quiet);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm512_cvtepi32_epi16(r));
+    }
+    for (; i < n; ++i)
+        dst[i] = floatToBFloat16(src[i]);
+}
+
+void unpackBFloat16(const std::uint16_t *src, float *dst, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m512i x = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i)));
+        _mm512_storeu_ps(dst + i, _mm512_castsi512_ps(_mm512_slli_epi32(x, 16)));
+    }
+    for (; i < n; ++i)
+        dst[i] = bfloat16ToFloat(src[i]);
+}
+
+} // namespace
+
+const Table &avx512Table() {
+    static const Table t =
+        SimdKernels<AVX512>::makeTable("avx512", packHalf, unpackHalf, packBFloat16, unpackBFloat16);
+    return t;
+}
+
+} // namespace ShallowWaterKernels
@@ -0,0 +1,133 @@
+#include <WaterSimulation/ShallowWaterCPU.h>
+
+#include <algorithm>
+
+// Stockage réduit du solveur CPU.
+// h, qx et qy sont gardés en fp16 ou bf16 dans des PackedGrid, ce qui divise par deux la mémoire et le trafic des
+// balayages tuilés : chaque tuile décode sa zone en float, avance stepsPerSweep pas puis réencode son intérieur.
+// Tout ce qui a besoin de l'état en float (init, accesseurs) passe par unpackState(), la copie float est relâchée
+// par packState() au début du pas suivant. Les textures et les réductions décodent ligne par ligne (stateRows).
+
+void ShallowWaterCPU::packRow(const float *src, std::uint16_t *dst, int n) const {
+    if (storagePrecision == StoragePrecision::Float16)
+        kernels->packHalf(src, dst, n);
+    else
+        kernels->packBFloat16(src, dst, n);
+}
+
+void ShallowWaterCPU::unpackRow(const std::uint16_t *src, float *dst, int n) const {
+    if (storagePrecision == StoragePrecision::Float16)
+        kernels->unpackHalf(src, dst, n);
+    else
+        kernels->unpackBFloat16(src, dst, n);
+}
+
+void ShallowWaterCPU::setStoragePrecision(StoragePrecision precision) {
+    if (precision == storagePrecision)
+        return;
+
+    unpackState(); // état courant en float, décodé avec l'ancien format
+    storagePrecision = precision;
+    activeTilesDirty = true;
+
+    if (!isPacked()) {
+        hPacked = PackedGrid{};
+        qxPacked = PackedGrid{};
+        qyPacked = PackedGrid{};
+        hPackedNext = PackedGrid{};
+        qxPackedNext = PackedGrid{};
+        qyPackedNext = PackedGrid{};
+
+        qxNext = PaddedGrid(nx + 1, ny, hugePages);
+        qyNext = PaddedGrid(nx, ny + 1, hugePages);
+        ux = PaddedGrid(nx + 1, ny, hugePages);
+        uy = PaddedGrid(nx, ny + 1, hugePages);
+        if (stepsPerSweep > 0)
+            hNext = PaddedGrid(nx, ny, hugePages);
+        floatStateModified = false;
+        return;
+    }
+
+    hPacked = PackedGrid(nx, ny, hugePages);
+    qxPacked = PackedGrid(nx + 1, ny, hugePages);
+    qyPacked = PackedGrid(nx, ny + 1, hugePages);
+    hPackedNext = PackedGrid(nx, ny, hugePages);
+    qxPackedNext = PackedGrid(nx + 1, ny, hugePages);
+    qyPackedNext = PackedGrid(nx, ny + 1, hugePages);
+
+    // les buffers float des passes globales ne servent plus
+    qxNext = PaddedGrid{};
+    qyNext = PaddedGrid{};
+    hNext = PaddedGrid{};
+
+    if (stepsPerSweep <= 0)
+        setTiling(4, tileWidth, tileHeight);
+
+    floatStateModified = true;
+    packState();
+}
+
+void ShallowWaterCPU::unpackState() {
+    if (floatStateValid)
+        return;
+
+    h = PaddedGrid(nx, ny, hugePages);
+    qx = PaddedGrid(nx + 1, ny, hugePages);
+    qy = PaddedGrid(nx, ny + 1, hugePages);
+
+    parallelRows(0, ny + 1, [&](int j0, int j1) {
+        for (int j = j0; j < j1; ++j) {
+            if (j < ny) {
+                unpackRow(hPacked.row(j), h.row(j), nx);
+                unpackRow(qxPacked.row(j), qx.row(j), nx + 1);
+            }
+            unpackRow(qyPacked.row(j), qy.row(j), nx);
+        }
+    });
+
+    floatStateValid = true;
+    floatStateModified = false;
+}
+
+void ShallowWaterCPU::packState() {
+    if (!isPacked() || !floatStateValid)
+        return;
+
+    if (floatStateModified) {
+        parallelRows(0, ny + 1, [&](int j0, int j1) {
+            for (int j = j0; j < j1; ++j) {
+                if (j < ny) {
+                    packRow(h.row(j), hPacked.row(j), nx);
+                    packRow(qx.row(j), qxPacked.row(j), nx + 1);
+                }
+                packRow(qy.row(j), qyPacked.row(j), nx);
+            }
+        });
+    }
+
+    h = PaddedGrid{};
+    qx = PaddedGrid{};
+    qy = PaddedGrid{};
+    ux = PaddedGrid{};
+    uy = PaddedGrid{};
+    floatStateValid = false;
+    floatStateModified = false;
+}
+
+void ShallowWaterCPU::stateRows(int j, float *buffer, const float *(&rows)[4]) const {
+    if (floatStateValid) {
+        rows[0] = h.row(j);
+        rows[1] = qx.row(j);
+        rows[2] = qy.row(j);
+        rows[3] = qy.row(j + 1);
+        return;
+    }
+
+    const int n = nx + 1;
+    unpackRow(hPacked.row(j), buffer, nx);
+    unpackRow(qxPacked.row(j), buffer + n, nx + 1);
+    unpackRow(qyPacked.row(j), buffer + 2 * n, nx);
+    unpackRow(qyPacked.row(j + 1), buffer + 3 * n, nx);
+    for (int k = 0; k < 4; ++k)
+        rows[k] = buffer + k * n;
+}
@@ -0,0 +1,200 @@
+#include <WaterSimulation/ShallowWaterCPU.h>
+
+#include <algorithm>
+
+// Balayage tuilé du solveur CPU.
+// Chaque tuile [ax, bx) x [ay, by) copie son contenu et un halo de stepCount cellules dans un buffer local,
+// y avance stepCount pas (flux + barrière + hauteur fusionnés ligne par ligne), puis écrit son intérieur dans
+// hNext / qxNext / qyNext. Un pas ne propage l'information que d'une cellule, le halo absorbe donc les valeurs
+// fausses des bords du buffer local et l'intérieur est identique au bit près à stepCount appels à step().
+
+void ShallowWaterCPU::setTiling(int steps, int width, int height) {
+    stepsPerSweep = std::max(isPacked() ? 1 : 0, steps); // le stockage réduit ne passe que par les balayages
+    tileWidth = std::max(1, width);
+    tileHeight = std::max(1, height);
+
+    if (stepsPerSweep > 0 && !isPacked() && hNext.width() != nx)
+        hNext = PaddedGrid(nx, ny, hugePages);
+    tileScratch.clear(); // réalloués au prochain balayage
+}
+
+void ShallowWaterCPU::advance(int stepCount) {
+    packState();
+
+    if (stepsPerSweep <= 0) {
+        for (int s = 0; s < stepCount; ++s)
+            step();
+        return;
+    }
+
+    while (stepCount > 0) {
+        const int n = std::min(stepCount, stepsPerSweep);
+        sweepTiles(n);
+        stepCount -= n;
+    }
+}
+
+void ShallowWaterCPU::sweepTiles(int stepCount) {
+    const int tilesX = (nx + tileWidth - 1) / tileWidth;
+    const int tilesY = (ny + tileHeight - 1) / tileHeight;
+    const int tileCount = tilesX * tilesY;
+    const int bands = std::min(static_cast<int>(threadCount()), tileCount);
+
+    const int scratchWidth = tileWidth + 2 * stepCount;
+    const int scratchHeight = tileHeight + 2 * stepCount;
+    if (static_cast<int>(tileScratch.size()) != bands || tileScratch[0].h.width() < scratchWidth ||
+        tileScratch[0].h.height() < scratchHeight) {
+        tileScratch.clear();
+        tileScratch.resize(bands);
+        for (TileScratch &scratch : tileScratch) {
+            scratch.h = PaddedGrid(scratchWidth, scratchHeight);
+            scratch.terrain = PaddedGrid(scratchWidth, scratchHeight);
+            scratch.qx = PaddedGrid(scratchWidth + 1, scratchHeight);
+            scratch.qy = PaddedGrid(scratchWidth, scratchHeight + 1);
+            scratch.qxNext = PaddedGrid(scratchWidth + 1, scratchHeight);
+            scratch.qyNext = PaddedGrid(scratchWidth, scratchHeight + 1);
+        }
+    }
+
+    // une bande = un buffer local, les tuiles d'une bande sont traitées dans l'ordre
+    parallelRows(0, bands, [&](int b0, int b1) {
+        for (int b = b0; b < b1; ++b) {
+            const int t0 = tileCount * b / bands;
+            const int t1 = tileCount * (b + 1) / bands;
+            for (int t = t0; t < t1; ++t) {
+                const int ax = (t % tilesX) * tileWidth;
+                const int ay = (t / tilesX) * tileHeight;
+                advanceTile(tileScratch[b], ax, std::min(nx, ax + tileWidth), ay, std::min(ny, ay + tileHeight),
+                            stepCount);
+            }
+        }
+    });
+
+    if (isPacked()) {
+        hPacked.swap(hPackedNext);
+        qxPacked.swap(qxPackedNext);
+        qyPacked.swap(qyPackedNext);
+    } else {
+        h.swap(hNext);
+        qx.swap(qxNext);
+        qy.swap(qyNext);
+    }
+    activeTilesDirty = true;
+}
+
+void ShallowWaterCPU::advanceTile(TileScratch &scratch, int ax, int bx, int ay, int by, int stepCount) {
+    const ShallowWaterKernels::Params p = kernelParams();
+
+    // zone locale : la tuile + le halo, coupée aux bords du domaine
+    const int cx0 = std::max(0, ax - stepCount);
+    const int cx1 = std::min(nx, bx + stepCount);
+    const int r0 = std::max(0, ay - stepCount);
+    const int r1 = std::min(ny, by + stepCount);
+    const int w = cx1 - cx0;
+
+    // copie de la zone locale, décodée en float si l'état est stocké sur 16 bits
+    const bool packed = isPacked();
+    auto load = [&](const PaddedGrid &grid, const PackedGrid &packedGrid, int j, int i0, int i1, float *dst) {
+        if (packed)
+            unpackRow(packedGrid.row(j) + i0, dst, i1 - i0);
+        else
+            std::copy(grid.row(j) + i0, grid.row(j) + i1, dst);
+    };
+    auto store = [&](const float *src, int i0, int i1, PaddedGrid &grid, PackedGrid &packedGrid, int j) {
+        if (packed)
+            packRow(src, packedGrid.row(j) + i0, i1 - i0);
+        else
+            std::copy(src, src + (i1 - i0), grid.row(j) + i0);
+    };
+
+    for (int j = r0; j < r1; ++j) {
+        load(h, hPacked, j, cx0, cx1, scratch.h.row(j - r0));
+        std::copy(terrain.row(j) + cx0, terrain.row(j) + cx1, scratch.terrain.row(j - r0));
+        load(qx, qxPacked, j, cx0, cx1 + 1, scratch.qx.row(j - r0));
+    }
+    for (int j = r0; j <= r1; ++j)
+        load(qy, qyPacked, j, cx0, cx1, scratch.qy.row(j - r0));
+
+    // faces calculées, en indices globaux (mêmes intervalles que updateFluxes)
+    const int fxRow0 = std::max(1, r0), fxRow1 = std::min(ny - 1, r1);
+    const int fxI0 = std::max(1, cx0 + 1), fxI1 = std::min(nx, cx1);
+    const int fyRow0 = std::max(1, r0 + 1), fyRow1 = std::min(ny, r1);
+    const int fyI0 = std::max(1, cx0), fyI1 = std::min(nx - 1, cx1);
+
+    for (int s = 0; s < stepCount; ++s) {
+        // les vitesses ne sont visibles qu'après le dernier pas, calculées directement dans ux / uy
+        // (pas en stockage réduit, voir updateMomentumTexture)
+        if (s == stepCount - 1 && !packed) {
+            for (int j = ay; j < by; ++j) {
+                const int l = j - r0;
+                const int i0 = std::max(1, ax);
+                kernels->velocity(p, scratch.h.row(l) - 1, scratch.terrain.row(l) - 1, scratch.h.row(l),
+                                  scratch.terrain.row(l), scratch.qx.row(l), ux.row(j) + cx0, i0 - cx0, bx - cx0);
+                if (ax == 0)
+                    ux.at(0, j) = 0.0f;
+                if (bx == nx)
+                    ux.at(nx, j) = 0.0f;
+            }
+            for (int j = std::max(1, ay); j < by; ++j) {
+                const int l = j - r0;
+                kernels->velocity(p, scratch.h.row(l - 1), scratch.terrain.row(l - 1), scratch.h.row(l),
+                                  scratch.terrain.row(l), scratch.qy.row(l), uy.row(j) + cx0, ax - cx0, bx - cx0);
+            }
+            if (ay == 0)
+                std::fill(uy.row(0) + ax, uy.row(0) + bx, 0.0f);
+            if (by == ny)
+                std::fill(uy.row(ny) + ax, uy.row(ny) + bx, 0.0f);
+        }
+
+        for (int j = fxRow0; j < fxRow1; ++j) {
+            const int l = j - r0;
+            kernels->fluxX(p, scratch.h.row(l), scratch.terrain.row(l), scratch.qx.row(l), scratch.qxNext.row(l),
+                           fxI0 - cx0, fxI1 - cx0);
+        }
+        for (int j = fyRow0; j < fyRow1; ++j) {
+            const int l = j - r0;
+            kernels->fluxY(p, scratch.h.row(l - 1), scratch.terrain.row(l - 1), scratch.h.row(l),
+                           scratch.terrain.row(l), scratch.qy.row(l - 1), scratch.qy.row(l), scratch.qy.row(l + 1),
+                           scratch.qyNext.row(l), fyI0 - cx0, fyI1 - cx0);
+        }
+
+        // faces jamais calculées + barrière, à 0 comme dans la version globale
+        for (int l = 0; l < r1 - r0; ++l) {
+            if (cx0 == 0)
+                scratch.qxNext.at(0, l) = 0.0f;
+            if (cx1 == nx)
+                scratch.qxNext.at(w, l) = 0.0f;
+        }
+        if (r0 == 0)
+            std::fill(scratch.qxNext.row(0), scratch.qxNext.row(0) + w + 1, 0.0f);
+        if (r1 == ny)
+            std::fill(scratch.qxNext.row(ny - 1 - r0), scratch.qxNext.row(ny - 1 - r0) + w + 1, 0.0f);
+        for (int l = 0; l <= r1 - r0; ++l) {
+            if (cx0 == 0)
+                scratch.qyNext.at(0, l) = 0.0f;
+            if (cx1 == nx)
+                scratch.qyNext.at(w - 1, l) = 0.0f;
+        }
+        if (r0 == 0)
+            std::fill(scratch.qyNext.row(0), scratch.qyNext.row(0) + w, 0.0f);
+        if (r1 == ny)
+            std::fill(scratch.qyNext.row(ny - r0), scratch.qyNext.row(ny - r0) + w, 0.0f);
+
+        scratch.qx.swap(scratch.qxNext);
+        scratch.qy.swap(scratch.qyNext);
+
+        for (int l = 0; l < r1 - r0; ++l)
+            kernels->height(p, scratch.h.row(l), scratch.qx.row(l), scratch.qy.row(l), scratch.qy.row(l + 1), 0, w);
+    }
+
+    // écriture de l'intérieur de la tuile
+    for (int j = ay; j < by; ++j) {
+        const int l = j - r0;
+        store(scratch.h.row(l) + (ax - cx0), ax, bx, hNext, hPackedNext, j);
+        const int faceEnd = bx == nx ? bx + 1 : bx;
+        store(scratch.qx.row(l) + (ax - cx0), ax, faceEnd, qxNext, qxPackedNext, j);
+        store(scratch.qy.row(l) + (ax - cx0), ax, bx, qyNext, qyPackedNext, j);
+    }
+    if (by == ny)
+        store(scratch.qy.row(ny - r0) + (ax - cx0), ax, bx, qyNext, qyPackedNext, ny);
+}
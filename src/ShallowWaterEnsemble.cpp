@@ -0,0 +1,168 @@
+#include <WaterSimulation/ShallowWaterEnsemble.h>
+#include <WaterSimulation/ProgramCache.h>
+
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/ArrayView.h>
+#include <Corrade/Utility/Resource.h>
+#include <Magnum/GL/ImageFormat.h>
+#include <Magnum/GL/Renderer.h>
+#include <Magnum/GL/Shader.h>
+#include <Magnum/GL/TextureFormat.h>
+#include <Magnum/GL/Version.h>
+#include <Magnum/ImageView.h>
+#include <Magnum/PixelFormat.h>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+static_assert(sizeof(ShallowWaterEnsemble::Member) == 4 * sizeof(float), "Member doit correspondre au std430 des shaders");
+
+ShallowWaterEnsemble::ComputeProgram::ComputeProgram(Magnum::Containers::StringView filepath,
+                                                     StoragePrecision precision) {
+    const char *formatDefine = precision == StoragePrecision::Float16 ? "#define STATE_FORMAT rgba16f\n"
+                                                                       : "#define STATE_FORMAT rgba32f\n";
+    Corrade::Utility::Resource rs{"WaterSimulationResources"};
+    const Corrade::Containers::StringView source = rs.getString(filepath);
+
+    const std::uint64_t cacheKey = ProgramCache::key({"#define ENSEMBLE\n", formatDefine, source});
+    if (ProgramCache::load(*this, cacheKey))
+        return;
+
+    Magnum::GL::Shader compute(Magnum::GL::Version::GL430, Magnum::GL::Shader::Type::Compute);
+    compute.addSource("#define ENSEMBLE\n");
+    compute.addSource(formatDefine);
+    compute.addSource(source);
+
+    CORRADE_INTERNAL_ASSERT_OUTPUT(compute.compile());
+
+    attachShader(compute);
+    setRetrievableBinary(!ProgramCache::directory().empty());
+    CORRADE_INTERNAL_ASSERT_OUTPUT(link());
+    ProgramCache::store(*this, cacheKey);
+}
+
+ShallowWaterEnsemble::ShallowWaterEnsemble(size_t nx_, size_t ny_, float dx_, float dt_, std::vector<Member> members,
+                                           int groups, StoragePrecision precision)
+    : m_members(std::move(members)) {
+    assert(!m_members.empty());
+    nx = nx_;
+    ny = ny_;
+    dx = dx_;
+    dt = dt_;
+    m_precision = precision;
+
+    // (nx + 1) x (ny + 1) texels
+    groupx = (nx + groups) / groups;
+    groupy = (ny + groups) / groups;
+
+    const Magnum::GL::TextureFormat stateFormat =
+        precision == StoragePrecision::Float16 ? Magnum::GL::TextureFormat::RGBA16F
+                                               : Magnum::GL::TextureFormat::RGBA32F;
+    const Magnum::Vector3i size{nx + 1, ny + 1, static_cast<int>(m_members.size())};
+
+    m_stateTexture.setStorage(1, stateFormat, size)
+        .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
+        .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
+    m_stateTexturePong.setStorage(1, stateFormat, size)
+        .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
+        .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
+
+    m_terrainTexture.setStorage(1, Magnum::GL::TextureFormat::R32F, {nx + 1, ny + 1})
+        .setMinificationFilter(Magnum::GL::SamplerFilter::Linear)
+        .setMagnificationFilter(Magnum::GL::SamplerFilter::Linear);
+
+    m_memberBuffer.setData(Corrade::Containers::ArrayView<const Member>{m_members.data(), m_members.size()},
+                           Magnum::GL::BufferUsage::StaticDraw);
+
+    m_updateProgram = ComputeProgram("updateFluxesHeight.comp", precision);
+    m_initProgram = ComputeProgram("init.comp", precision);
+    m_totalMassProgram = ComputeProgram("totalMass.comp", precision);
+}
+
+Magnum::GL::ImageFormat ShallowWaterEnsemble::stateImageFormat() const {
+    return m_precision == StoragePrecision::Float16 ? Magnum::GL::ImageFormat::RGBA16F
+                                                    : Magnum::GL::ImageFormat::RGBA32F;
+}
+
+void ShallowWaterEnsemble::step() {
+    const unsigned int members = static_cast<unsigned int>(m_members.size());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_memberBuffer.id());
+
+    m_stateTexture.bindImageLayered(0, 0, Magnum::GL::ImageAccess::ReadOnly, stateImageFormat());
+    m_stateTexturePong.bindImageLayered(1, 0, Magnum::GL::ImageAccess::WriteOnly, stateImageFormat());
+    m_terrainTexture.bindImage(2, 0, Magnum::GL::ImageAccess::ReadOnly, Magnum::GL::ImageFormat::R32F);
+    m_updateProgram.setFloatUniform("dx", dx).setFloatUniform("dt", dt).run(groupx, groupy, members);
+
+    Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+
+    std::swap(m_stateTexture, m_stateTexturePong);
+}
+
+void ShallowWaterEnsemble::init(int initType) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_memberBuffer.id());
+    m_stateTexture.bindImageLayered(1, 0, Magnum::GL::ImageAccess::WriteOnly, stateImageFormat());
+    m_terrainTexture.bindImage(2, 0, Magnum::GL::ImageAccess::ReadOnly, Magnum::GL::ImageFormat::R32F);
+    m_initProgram.setIntUniform("init_type", initType).run(groupx, groupy, static_cast<unsigned int>(m_members.size()));
+
+    Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::ShaderImageAccess);
+}
+
+void ShallowWaterEnsemble::initBump() { init(0); }
+void ShallowWaterEnsemble::initDamBreak() { init(1); }
+void ShallowWaterEnsemble::initTsunami() { init(3); }
+
+void ShallowWaterEnsemble::loadTerrainHeightMap(Magnum::Trade::ImageData2D *img, float scaling, int channels) {
+    CORRADE_INTERNAL_ASSERT(channels >= 1 && channels <= 4);
+
+    Magnum::Vector2i size = img->size();
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(img->data().data());
+    Corrade::Containers::Array<char> floatData{std::size_t(size.x() * size.y()) * sizeof(float)};
+    float *scaled = reinterpret_cast<float *>(floatData.data());
+
+    for (std::size_t i = 0; i < std::size_t(size.x() * size.y()); ++i) {
+        float h = 0.0f;
+        for (int c = 0; c < channels; ++c)
+            h += data[i * channels + c] / 255.0f;
+        h /= channels;
+        scaled[i] = h * scaling;
+    }
+
+    Magnum::ImageView2D floatImg{Magnum::PixelFormat::R32F, size, floatData};
+
+    m_terrainTexture = Magnum::GL::Texture2D{};
+    m_terrainTexture.setStorage(1, Magnum::GL::TextureFormat::R32F, size)
+        .setMinificationFilter(Magnum::GL::SamplerFilter::Nearest)
+        .setMagnificationFilter(Magnum::GL::SamplerFilter::Nearest)
+        .setSubImage(0, {}, floatImg);
+}
+
+std::size_t ShallowWaterEnsemble::memoryUsage() {
+    const Magnum::PixelFormat state =
+        m_precision == StoragePrecision::Float16 ? Magnum::PixelFormat::RGBA16F : Magnum::PixelFormat::RGBA32F;
+    return ShallowWater::textureBytes(m_stateTexture, state) + ShallowWater::textureBytes(m_stateTexturePong, state) +
+           ShallowWater::textureBytes(m_terrainTexture, Magnum::PixelFormat::R32F) +
+           ShallowWater::bufferBytes(m_memberBuffer) + ShallowWater::bufferBytes(m_massBuffer);
+}
+
+std::vector<double> ShallowWaterEnsemble::totalVolumes() {
+    const std::size_t members = m_members.size();
+    const std::size_t groups = std::size_t(groupx) * std::size_t(groupy);
+    m_massBuffer.setData({nullptr, members * groups * sizeof(float)}, Magnum::GL::BufferUsage::DynamicRead);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_massBuffer.id());
+    m_stateTexture.bindImageLayered(0, 0, Magnum::GL::ImageAccess::ReadOnly, stateImageFormat());
+    m_totalMassProgram.run(groupx, groupy, static_cast<unsigned int>(members));
+
+    Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::BufferUpdate);
+
+    Corrade::Containers::Array<char> data = m_massBuffer.subData(0, members * groups * sizeof(float));
+    const float *partialSums = reinterpret_cast<const float *>(data.data());
+    std::vector<double> volumes(members, 0.0);
+    for (std::size_t k = 0; k < members; ++k) {
+        for (std::size_t i = 0; i < groups; ++i)
+            volumes[k] += partialSums[k * groups + i];
+        volumes[k] *= dx * dx;
+    }
+    return volumes;
+}
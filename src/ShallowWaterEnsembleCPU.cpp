@@ -0,0 +1,224 @@
+#include <WaterSimulation/ShallowWaterEnsembleCPU.h>
+
+#include <Corrade/Utility/Debug.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+
+ShallowWaterEnsembleCPU::ShallowWaterEnsembleCPU(size_t nx_, size_t ny_, float dx_, float dt_,
+                                                 std::vector<Member> members_, unsigned threads, bool hugePages)
+    : members(std::move(members_)) {
+    assert(!members.empty());
+    nx = nx_; ny = ny_; dx = dx_;
+    memberCount = static_cast<int>(members.size());
+    setTimestep(dt_);
+
+    const int K = memberCount;
+    h = PaddedGrid(nx * K, ny, hugePages);
+    terrain = PaddedGrid(nx * K, ny, hugePages);
+    qx = PaddedGrid((nx + 1) * K, ny, hugePages);
+    qy = PaddedGrid(nx * K, ny + 1, hugePages);
+    qxNext = PaddedGrid((nx + 1) * K, ny, hugePages);
+    qyNext = PaddedGrid(nx * K, ny + 1, hugePages);
+
+    // 16 = largeur des registres AVX-512, multiple de toutes les autres
+    lanePeriod = std::lcm(K, 16);
+    laneDryEps.resize(lanePeriod);
+    laneGravity.resize(lanePeriod);
+    laneFriction.resize(lanePeriod);
+    for (int lane = 0; lane < lanePeriod; ++lane) {
+        const Member &m = members[lane % K];
+        laneDryEps[lane] = m.dryEps;
+        laneGravity[lane] = m.gravity;
+        laneFriction[lane] = m.friction_coef;
+    }
+
+    setThreadCount(threads);
+}
+
+void ShallowWaterEnsembleCPU::setThreadCount(unsigned threads) {
+    if (threads == 1) {
+        pool.reset();
+        return;
+    }
+    pool = std::make_unique<ThreadPool>(threads);
+    if (pool->size() == 1)
+        pool.reset();
+}
+
+void ShallowWaterEnsembleCPU::parallelRows(int begin, int end, const std::function<void(int, int)> &fn) {
+    if (pool)
+        pool->parallelFor(begin, end, fn);
+    else
+        fn(begin, end);
+}
+
+void ShallowWaterEnsembleCPU::setKernelIsa(ShallowWaterKernels::Isa isa) {
+    kernels = &ShallowWaterKernels::table(isa);
+}
+
+void ShallowWaterEnsembleCPU::setTimestep(float dt_) {
+    dt = dt_;
+    limitCFL = dx / (5.0f * dt);
+}
+
+ShallowWaterKernels::Params ShallowWaterEnsembleCPU::kernelParams() const {
+    const Member &m = members.front(); // les champs propres aux membres sont remplacés par lane
+    return ShallowWaterKernels::Params{dx, dt, m.gravity, m.dryEps, m.friction_coef, limitCFL};
+}
+
+ShallowWaterKernels::EnsembleParams ShallowWaterEnsembleCPU::ensembleParams() const {
+    return ShallowWaterKernels::EnsembleParams{memberCount, lanePeriod, laneDryEps.data(), laneGravity.data(),
+                                               laneFriction.data()};
+}
+
+// mêmes faces que ShallowWaterCPU::updateFluxes, les indices de cellule sont multipliés par K
+void ShallowWaterEnsembleCPU::updateFluxes() {
+    const ShallowWaterKernels::Params p = kernelParams();
+    const ShallowWaterKernels::EnsembleParams e = ensembleParams();
+    const int K = memberCount;
+
+    parallelRows(1, ny - 1, [&](int j0, int j1) {
+        for (int j = j0; j < j1; ++j) {
+            // faces 1 à nx - 1 : cellules i - 1 et i, flux i - 1, i, i + 1
+            const float *hRow = h.row(j);
+            const float *terrainRow = terrain.row(j);
+            const float *qxRow = qx.row(j);
+            kernels->ensembleFlux(p, e, hRow, terrainRow, hRow + K, terrainRow + K, qxRow, qxRow + K, qxRow + 2 * K,
+                                  qxNext.row(j) + K, (nx - 1) * K);
+        }
+    });
+
+    parallelRows(1, ny, [&](int j0, int j1) {
+        for (int j = j0; j < j1; ++j) {
+            kernels->ensembleFlux(p, e, h.row(j - 1) + K, terrain.row(j - 1) + K, h.row(j) + K, terrain.row(j) + K,
+                                  qy.row(j - 1) + K, qy.row(j) + K, qy.row(j + 1) + K, qyNext.row(j) + K,
+                                  (nx - 2) * K);
+        }
+    });
+
+    qx.swap(qxNext);
+    qy.swap(qyNext);
+}
+
+void ShallowWaterEnsembleCPU::updateWaterHeight() {
+    const ShallowWaterKernels::Params p = kernelParams();
+    const int K = memberCount;
+
+    parallelRows(0, ny, [&](int j0, int j1) {
+        for (int j = j0; j < j1; ++j) {
+            kernels->ensembleHeight(p, h.row(j), qx.row(j), qx.row(j) + K, qy.row(j), qy.row(j + 1), nx * K);
+        }
+    });
+}
+
+void ShallowWaterEnsembleCPU::step() {
+    // les faces de bord ne sont jamais écrites et restent à 0 (applyBarrier de ShallowWaterCPU),
+    // les vitesses ne servent qu'à l'affichage et ne sont pas calculées
+    updateFluxes();
+    updateWaterHeight();
+}
+
+void ShallowWaterEnsembleCPU::advance(int stepCount) {
+    for (int s = 0; s < stepCount; ++s)
+        step();
+}
+
+std::size_t ShallowWaterEnsembleCPU::memoryUsage() const {
+    return h.bytes() + qx.bytes() + qy.bytes() + qxNext.bytes() + qyNext.bytes() + terrain.bytes() +
+           3 * lanePeriod * sizeof(float);
+}
+
+void ShallowWaterEnsembleCPU::loadTerrainHeightMap(Magnum::Trade::ImageData2D *img, float scaling) {
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(img->data().data());
+    const int channels = 4;
+
+    PaddedGrid source(nx, ny);
+    for (int j = 0; j < ny; ++j) {
+        for (int i = 0; i < nx; ++i) {
+            const uint8_t r = data[(j * nx + i) * channels + 0];
+            source.at(i, j) = r * scaling / 255.0f;
+        }
+    }
+    setTerrain(source);
+}
+
+void ShallowWaterEnsembleCPU::setTerrain(const PaddedGrid &source) {
+    assert(source.width() == nx && source.height() == ny);
+    const int K = memberCount;
+
+    parallelRows(0, ny, [&](int j0, int j1) {
+        for (int j = j0; j < j1; ++j) {
+            const float *src = source.row(j);
+            float *dst = terrain.row(j);
+            for (int i = 0; i < nx; ++i)
+                std::fill(dst + i * K, dst + (i + 1) * K, src[i]);
+        }
+    });
+}
+
+void ShallowWaterEnsembleCPU::initBump() {
+    const int K = memberCount;
+    const int centerX = nx / 2;
+    const int centerY = ny / 2;
+    const float bumpHeight = 2.0f;
+
+    for (int j = 0; j < ny; ++j) {
+        for (int i = 0; i < nx; ++i) {
+            float distance = std::sqrt(static_cast<float>((i - centerX) * (i - centerX) +
+                                                          (j - centerY) * (j - centerY)));
+            float radius = 16.0f;
+            for (int k = 0; k < K; ++k) {
+                const Member &m = members[k];
+                float baseLevel = 2.0f + m.levelOffset;
+                float &cell = h.at(i * K + k, j);
+                float totalHeight = baseLevel - terrain.at(i * K + k, j);
+                if (totalHeight <= m.dryEps) {cell = 0.0f; continue;}
+                cell = totalHeight;
+                if (distance < radius)
+                    cell += bumpHeight * (1.0f - distance / radius);
+            }
+        }
+    }
+    qx.fill(0.0f);
+    qy.fill(0.0f);
+}
+
+void ShallowWaterEnsembleCPU::initTop() {
+    const int K = memberCount;
+    const int damPosition = ny / 6;
+
+    for (int j = 0; j < ny; ++j) {
+        for (int i = 0; i < nx; ++i) {
+            for (int k = 0; k < K; ++k) {
+                float waterLevel = 3.0f + members[k].levelOffset;
+                h.at(i * K + k, j) = j < damPosition ? std::max(0.0f, waterLevel - terrain.at(i * K + k, j)) : 0.0f;
+            }
+        }
+    }
+    qx.fill(0.0f);
+    qy.fill(0.0f);
+}
+
+void ShallowWaterEnsembleCPU::copyWaterHeight(int k, PaddedGrid &out) const {
+    if (out.width() != nx || out.height() != ny)
+        out = PaddedGrid(nx, ny);
+    for (int j = 0; j < ny; ++j) {
+        const float *src = h.row(j) + k;
+        float *dst = out.row(j);
+        for (int i = 0; i < nx; ++i)
+            dst[i] = src[i * memberCount];
+    }
+}
+
+double ShallowWaterEnsembleCPU::totalVolume(int k) const {
+    double volume = 0.0;
+    for (int j = 0; j < ny; ++j) {
+        const float *row = h.row(j) + k;
+        for (int i = 0; i < nx; ++i)
+            volume += row[i * memberCount];
+    }
+    return volume * dx * dx;
+}
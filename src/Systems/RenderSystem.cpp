@@ -56,7 +56,10 @@ void RenderSystem::render(Registry& registry,
         Debug{} << "No sun entity found with DirectionalLightComponent and ShadowCasterComponent";
     }
 
-    m_shadowMapPass.render(registry, cam, m_lightViewProjMatrix);
+    {
+        GpuProfiler::Scope profile{m_profiler, "shadow map"};
+        m_shadowMapPass.render(registry, cam, m_lightViewProjMatrix);
+    }
     
     if(m_renderShadowMapOnly){
         if (shadowCastData) {
@@ -72,41 +75,50 @@ void RenderSystem::render(Registry& registry,
         }
     }
 
-    m_opaquePass.render(registry, cam, m_lightViewProjMatrix, m_shadowMapPass.getDepthTexture());
+    {
+        GpuProfiler::Scope profile{m_profiler, "opaque"};
+        m_opaquePass.render(registry, cam, m_lightViewProjMatrix, m_shadowMapPass.getDepthTexture());
+    }
 
     if(m_renderDepthOnly){
         drawFullscreenTextureDebugDepth(m_opaquePass.getDepthTexture(), cam.near(), cam.far(), false);
         return;
     }
 
-    m_causticPass.render(registry, 
-        cam, 
-        m_shadowMapPass.getDepthTexture(), 
-        m_shadowMapPass.getColorTexture(),
-        m_opaquePass.getDepthTexture(),
-        lightPosition,
-        m_lightViewProjMatrix,
-        cam.near(),
-        cam.far(),
-        shadowCastData->far
-    );
+    {
+        GpuProfiler::Scope profile{m_profiler, "caustics"};
+        m_causticPass.render(registry, 
+            cam, 
+            m_shadowMapPass.getDepthTexture(), 
+            m_shadowMapPass.getColorTexture(),
+            m_opaquePass.getDepthTexture(),
+            lightPosition,
+            m_lightViewProjMatrix,
+            cam.near(),
+            cam.far(),
+            shadowCastData->far
+        );
+    }
 
     if(m_renderCausticMapOnly){
         drawFullscreenTexture(m_causticPass.getCausticTexture(), cam.near(), cam.far());
         return;
     }
 
-    m_godrayPass.render(registry, 
-        cam, 
-        m_shadowMapPass.getDepthTexture(), 
-        m_shadowMapPass.getColorTexture(),
-        m_opaquePass.getDepthTexture(),
-        lightPosition,
-        m_lightViewProjMatrix,
-        cam.near(),
-        cam.far(),
-        shadowCastData->far
-    );
+    {
+        GpuProfiler::Scope profile{m_profiler, "god rays"};
+        m_godrayPass.render(registry, 
+            cam, 
+            m_shadowMapPass.getDepthTexture(), 
+            m_shadowMapPass.getColorTexture(),
+            m_opaquePass.getDepthTexture(),
+            lightPosition,
+            m_lightViewProjMatrix,
+            cam.near(),
+            cam.far(),
+            shadowCastData->far
+        );
+    }
 
     if(m_renderGodRayMapOnly){
         drawFullscreenTexture(m_godrayPass.getGodRayTexture(), cam.near(), cam.far());
@@ -114,16 +126,19 @@ void RenderSystem::render(Registry& registry,
     }
 
 
-    m_compositionPass.render(
-        m_heightmapReadback,
-        cam.position(),
-        m_opaquePass.getColorTexture(),
-        m_causticPass.getCausticTexture(),
-        m_godrayPass.getGodRayTexture(),
-        m_opaquePass.getDepthTexture(),
-        registry,
-        viewMatrix,
-        projectionMatrix);
+    {
+        GpuProfiler::Scope profile{m_profiler, "composition"};
+        m_compositionPass.render(
+            m_heightmapReadback,
+            cam.position(),
+            m_opaquePass.getColorTexture(),
+            m_causticPass.getCausticTexture(),
+            m_godrayPass.getGodRayTexture(),
+            m_opaquePass.getDepthTexture(),
+            registry,
+            viewMatrix,
+            projectionMatrix);
+    }
 
     // debug : afficher les données de la heightmap cpu
    // GL::defaultFramebuffer.bind();
@@ -0,0 +1,43 @@
+#include <WaterSimulation/TextureUploader.h>
+
+#include <Corrade/Containers/ArrayView.h>
+#include <Magnum/GL/Buffer.h>
+#include <Magnum/PixelStorage.h>
+
+#include <cassert>
+
+std::uint8_t *TextureUploader::map(Magnum::PixelFormat format, const Magnum::Vector2i &size) {
+    assert(!m_mapped);
+
+    if (m_ring.empty() || format != m_format || size != m_size) {
+        m_format = format;
+        m_size = size;
+        m_byteSize = std::size_t(size.x()) * std::size_t(size.y()) * Magnum::pixelFormatSize(format);
+        m_ring.clear();
+        for (int i = 0; i < ringSize; ++i)
+            m_ring.emplace_back(Magnum::PixelStorage{}.setAlignment(1), format, size,
+                                Corrade::Containers::ArrayView<const void>{nullptr, m_byteSize},
+                                Magnum::GL::BufferUsage::StreamDraw);
+        m_index = 0;
+    }
+
+    Corrade::Containers::ArrayView<char> data = m_ring[m_index].buffer().map(
+        0, m_byteSize, Magnum::GL::Buffer::MapFlag::Write | Magnum::GL::Buffer::MapFlag::InvalidateBuffer);
+    if (!data)
+        return nullptr;
+
+    m_mapped = true;
+    return reinterpret_cast<std::uint8_t *>(data.data());
+}
+
+void TextureUploader::upload(Magnum::GL::Texture2D &texture) {
+    assert(m_mapped);
+    m_mapped = false;
+
+    Magnum::GL::BufferImage2D &image = m_ring[m_index];
+    if (!image.buffer().unmap()) // contenu perdu (changement de mode vidéo...), on saute cette image
+        return;
+
+    texture.setSubImage(0, {}, image);
+    m_index = (m_index + 1) % ringSize;
+}
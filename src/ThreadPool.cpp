@@ -0,0 +1,92 @@
+#include <WaterSimulation/ThreadPool.h>
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    // le thread appelant travaille aussi, il faut donc threadCount - 1 workers
+    m_workers.reserve(threadCount - 1);
+    for (unsigned i = 1; i < threadCount; ++i)
+        m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto &worker : m_workers)
+        worker.join();
+}
+
+int ThreadPool::bandStart(int begin, int end, unsigned bands, unsigned index) {
+    return begin + static_cast<int>((static_cast<long long>(end - begin) * index) / bands);
+}
+
+unsigned ThreadPool::bandIndex(int begin, int end, int bandBegin) const {
+    // les bandes non vides ont des débuts distincts : la dernière qui commence à bandBegin est la bonne
+    const unsigned bands = size();
+    unsigned index = 0;
+    for (unsigned i = 0; i < bands; ++i)
+        if (bandStart(begin, end, bands, i) == bandBegin)
+            index = i;
+    return index;
+}
+
+void ThreadPool::runBand(unsigned index) {
+    const int bandBegin = bandStart(m_begin, m_end, size(), index);
+    const int bandEnd = bandStart(m_begin, m_end, size(), index + 1);
+    if (bandBegin < bandEnd)
+        (*m_task)(bandBegin, bandEnd);
+}
+
+void ThreadPool::parallelFor(int begin, int end, const std::function<void(int, int)> &fn) {
+    if (end <= begin)
+        return;
+
+    if (m_workers.empty()) {
+        fn(begin, end);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &fn;
+        m_begin = begin;
+        m_end = end;
+        m_pending = static_cast<unsigned>(m_workers.size());
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    runBand(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_pending == 0; });
+    m_task = nullptr;
+}
+
+void ThreadPool::workerLoop(unsigned index) {
+    std::size_t seenGeneration = 0;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stop || m_generation != seenGeneration; });
+            if (m_stop)
+                return;
+            seenGeneration = m_generation;
+        }
+
+        runBand(index);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_pending == 0)
+                m_done.notify_one();
+        }
+    }
+}
@@ -43,7 +43,7 @@ void WaterSimulation::UIManager::drawUI(Application &app) {
     sunWindow(app.registry());
 
     cameraWindow(app.camera());
-    // perfWindow();
+    perfWindow(app.gpuProfiler());
 
     if (!app.cursorLocked())
         imgui.updateApplicationCursor(app);
@@ -61,6 +61,57 @@ void WaterSimulation::UIManager::drawUI(Application &app) {
     GL::Renderer::disable(GL::Renderer::Feature::Blending);
 }
 
+void WaterSimulation::UIManager::perfWindow(GpuProfiler &profiler) {
+    ImGui::Begin("GPU Profiler");
+
+    ImGui::Checkbox("Enabled", &profiler.enabled);
+    ImGui::SameLine();
+    if (ImGui::Button("Clear"))
+        profiler.clear();
+    ImGui::SameLine();
+    static const char *exportStatus = "";
+    if (ImGui::Button("Export CSV"))
+        exportStatus = profiler.writeCsv("gpu_profile.csv") ? "written to gpu_profile.csv"
+                                                            : "could not write gpu_profile.csv";
+    ImGui::SameLine();
+    ImGui::TextUnformatted(exportStatus);
+
+    ImGui::Text("%zu frames measured, %zu dropped (results not ready)", profiler.resolvedFrames(),
+                profiler.droppedFrames());
+
+    if (ImGui::BeginTable("gpuSections", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Section");
+        ImGui::TableSetupColumn("Last ms");
+        ImGui::TableSetupColumn("Avg ms");
+        ImGui::TableSetupColumn("Max ms");
+        ImGui::TableHeadersRow();
+
+        float total = 0.0f;
+        for (const GpuProfiler::Section &section : profiler.sections()) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(section.name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", double(section.last));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", double(section.average));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", double(section.max));
+            total += section.average;
+        }
+
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted("total");
+        ImGui::TableNextColumn();
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", double(total));
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
+
 void WaterSimulation::UIManager::sceneGraph() {
     // test fenêtre
     {
@@ -149,7 +200,21 @@ void WaterSimulation::UIManager::paramWindow(
         ImGui::Separator();
         
         ImGui::Checkbox("Airy Waves Enabled", &simulation->airyWavesEnabled);
+        if (!simulation->airyWavesSupported())
+            ImGui::TextDisabled("No FFT for this grid size, Airy waves are off");
+        if (!simulation->airyWavesEnabled || !simulation->airyWavesSupported()) {
+            ImGui::Checkbox("Fused Flux/Height Kernel", &simulation->fusedStepEnabled);
+            ImGui::Checkbox("Wet Tiles Only", &simulation->activeTilesEnabled);
+        }
+        const ComputeGraph &graph = simulation->computeGraph();
+        ImGui::Text("Step graph: %d passes, %d barriers, %.1f MB transient", graph.passCount(),
+                    graph.barrierCount(), graph.poolBytes() / (1024.0 * 1024.0));
         ImGui::InputInt("Step Number", &(app->step_number), 1, 10);
+        ImGui::Checkbox("Adaptive Timestep (CFL)", &simulation->adaptiveTimestep);
+        if (simulation->adaptiveTimestep) {
+            ImGui::SliderFloat("CFL Number", &simulation->cflNumber, 0.05f, 1.0f, "%.2f");
+            ImGui::Text("dt: %.5f s (%d substeps per frame)", simulation->getdt(), simulation->getLastSubsteps());
+        }
 
         ImGui::Separator();
         ImGui::Text("Base Parameters");
@@ -161,7 +226,17 @@ void WaterSimulation::UIManager::paramWindow(
         ImGui::Text("Airy Waves Parameters");
         
         ImGui::SliderFloat("Decomposition D (The higher it is, the less airy waves we have) ", &simulation->decompositionD, 0.000001f, 1.0f, "%.4f", ImGuiSliderFlags_Logarithmic);
-        ImGui::SliderInt("Diffusion Iterations", &simulation->diffusionIterations, 1, 512);
+        ImGui::SliderInt("Diffusion Strength (explicit steps)", &simulation->diffusionIterations, 1, 512);
+        ImGui::SliderInt("Max V-Cycles", &simulation->maxDecompositionCycles, 1, 32);
+        ImGui::InputFloat("V-Cycle Tolerance", &simulation->decompositionTolerance, 0.0f, 0.0f, "%.1e");
+        // la lecture attend la fin du GPU, seulement quand le noeud est ouvert
+        if (simulation->airyWavesEnabled && simulation->airyWavesSupported() &&
+            ImGui::TreeNode("Decomposition Convergence")) {
+            float correction = 0.0f;
+            int cycles = simulation->readDecompositionCycles(correction);
+            ImGui::Text("%d V-cycles, last correction %.2e", cycles, correction);
+            ImGui::TreePop();
+        }
         //ImGui::SliderFloat("Airy h_bar", &simulation->airyHBar, 0.1f, 20.0f, "%.2f");
         //ImGui::SliderFloat("Transport Gamma", &simulation->transportGamma, 0.0f, 1.0f, "%.3f");
 
@@ -197,6 +272,14 @@ void WaterSimulation::UIManager::paramWindow(
         
         ImVec2 texSize(512, 512);
 
+        // les étapes 3 à 6 ne sont copiées que sur demande : en continu (un pas par frame) ou une seule fois
+        static bool continuousCapture = false;
+        ImGui::Checkbox("Capture Every Frame", &continuousCapture);
+        ImGui::SameLine();
+        if (ImGui::Button("Capture Next Step") || (continuousCapture && !ImGui::IsWindowCollapsed()))
+            simulation->requestDebugCapture();
+        const bool captured = simulation->hasDebugTextures();
+
         if (ImGui::CollapsingHeader("1. Input State", ImGuiTreeNodeFlags_DefaultOpen)) {
             ImGui::Text("State");
             ImGui::SameLine(100);
@@ -237,14 +320,17 @@ void WaterSimulation::UIManager::paramWindow(
                 texSize);
         }
 
-        if (ImGui::CollapsingHeader("3. Shallow Water (Bulk)", ImGuiTreeNodeFlags_DefaultOpen)) {
+        if (!captured)
+            ImGui::TextDisabled("Capture a step to inspect stages 3 to 6");
+
+        if (captured && ImGui::CollapsingHeader("3. Shallow Water (Bulk)", ImGuiTreeNodeFlags_DefaultOpen)) {
             ImGui::Text("Bulk Updated");
             ImGui::Image(
                 reinterpret_cast<void *>(simulation->getVisBulkUpdated().id()),
                 texSize);
         }
 
-        if (ImGui::CollapsingHeader("4. FFT (On Airy Waves Quantities)", ImGuiTreeNodeFlags_DefaultOpen)) {
+        if (captured && ImGui::CollapsingHeader("4. FFT (On Airy Waves Quantities)", ImGuiTreeNodeFlags_DefaultOpen)) {
             ImGui::Text("FFT Height");
             ImGui::SameLine(100);
             ImGui::Text("FFT Qx");
@@ -264,7 +350,7 @@ void WaterSimulation::UIManager::paramWindow(
                 texSize);
         }
 
-        if (ImGui::CollapsingHeader("5. IFFT (Back to Spatial)", ImGuiTreeNodeFlags_DefaultOpen)) {
+        if (captured && ImGui::CollapsingHeader("5. IFFT (Back to Spatial)", ImGuiTreeNodeFlags_DefaultOpen)) {
             ImGui::Text("IFFT Height");
             ImGui::SameLine(100);
             ImGui::Text("IFFT Qx");
@@ -284,7 +370,7 @@ void WaterSimulation::UIManager::paramWindow(
                 texSize);
         }
 
-        if (ImGui::CollapsingHeader("6. Surface Transport", ImGuiTreeNodeFlags_DefaultOpen)) {
+        if (captured && ImGui::CollapsingHeader("6. Surface Transport", ImGuiTreeNodeFlags_DefaultOpen)) {
             ImGui::Text("Transported Flow");
             ImGui::SameLine(150);
             ImGui::Text("Transported Height");
@@ -0,0 +1,538 @@
+// Banc d'essai sans fenêtre ni rendu : charge un terrain, initialise un scénario, enchaîne N pas et
+// affiche ms/pas, cellules/s et mémoire utilisée.
+// Le backend CPU ne touche au GL qu'avec --visualize, le backend GPU crée un contexte EGL sans surface (Mesa llvmpipe
+// suffit).
+//
+//   WaterSimBench --backend cpu --nx 1023 --ny 1023 --steps 500 --heightmap resources/heightmaps/canyon.png
+//   WaterSimBench --backend gpu --scenario tsunami --csv
+
+#include <WaterSimulation/ShallowWaterCPU.h>
+#include <WaterSimulation/ShallowWaterEnsembleCPU.h>
+
+#include <Corrade/Containers/Optional.h>
+#include <Corrade/Containers/Pointer.h>
+#include <Corrade/PluginManager/Manager.h>
+#include <Corrade/Utility/Arguments.h>
+#include <Corrade/Utility/ConfigurationGroup.h>
+#include <Corrade/Utility/Debug.h>
+
+#include <Magnum/Magnum.h>
+#include <Magnum/Math/Vector2.h>
+#include <Magnum/Trade/AbstractImageConverter.h>
+#include <Magnum/Trade/AbstractImporter.h>
+#include <Magnum/Trade/ImageData.h>
+
+#ifdef WATERSIM_BENCH_GPU
+#include <WaterSimulation/ShallowWater.h>
+#include <WaterSimulation/ShallowWaterEnsemble.h>
+#include <WaterSimulation/WaterWorld.h>
+
+#include <Magnum/GL/Context.h>
+#include <Magnum/GL/Renderer.h>
+#include <Magnum/GL/Texture.h>
+#include <Magnum/GL/TextureFormat.h>
+#include <Magnum/Platform/GLContext.h>
+#include <Magnum/Platform/WindowlessEglApplication.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace Magnum;
+using Corrade::Utility::Debug;
+using Corrade::Utility::Error;
+
+namespace {
+
+struct BenchOptions {
+    std::string backend;
+    std::string scenario;
+    std::string heightmap;
+    std::string precision; // fp32, fp16 ou bf16 (cpu seulement)
+    float terrainScaling;
+    int nx, ny;
+    float dx, dt;
+    int steps;
+    int warmup;
+    int members; // > 1 : ensemble de variantes avancées ensemble
+    int worldTiles; // > 1 : WaterWorld de worldTiles x worldTiles tuiles de nx cellules (gpu)
+    bool visualize; // cpu : met à jour les textures de hauteur et de vitesse à chaque pas, comme l'application
+    bool csv;
+};
+
+struct BenchResult {
+    double seconds = 0.0;
+    std::size_t solverBytes = 0; // 0 si le backend ne sait pas le mesurer
+    double volumeBefore = 0.0;   // volume d'eau avant / après les pas chronométrés, pour la dérive de masse
+    double volumeAfter = 0.0;
+    double cells = 0.0; // cellules simulées par pas, 0 = nx * ny * members
+};
+
+// pic de mémoire résidente du processus, en octets (0 si indisponible)
+std::size_t peakResidentBytes() {
+#if defined(__APPLE__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return std::size_t(usage.ru_maxrss); // octets sur macOS
+#elif defined(__unix__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return std::size_t(usage.ru_maxrss) * 1024; // Ko sur Linux
+#else
+    return 0;
+#endif
+}
+
+// charge le heightmap et le redimensionne en width x height avec channels composantes
+Containers::Optional<Trade::ImageData2D> loadHeightmap(const std::string &file, Vector2i size, int channels) {
+    PluginManager::Manager<Trade::AbstractImporter> importerManager;
+    PluginManager::Manager<Trade::AbstractImageConverter> converterManager;
+
+    Containers::Pointer<Trade::AbstractImporter> importer = importerManager.loadAndInstantiate("StbImageImporter");
+    Containers::Pointer<Trade::AbstractImageConverter> converter =
+        converterManager.loadAndInstantiate("StbResizeImageConverter");
+    if (!importer || !converter) {
+        Error{} << "Could not load the STB importer / resize plugins";
+        return {};
+    }
+
+    importer->configuration().setValue("forceChannelCount", channels);
+    if (!importer->openFile(file)) {
+        Error{} << "Could not open heightmap" << file.c_str();
+        return {};
+    }
+
+    Containers::Optional<Trade::ImageData2D> image = importer->image2D(0);
+    if (!image)
+        return {};
+
+    converter->configuration().setValue("size", std::to_string(size.x()) + " " + std::to_string(size.y()));
+    return converter->convert(*image);
+}
+
+// variantes de l'ensemble : frottement et niveau d'eau initial croissants, membre 0 = paramètres par défaut
+template <class Member> std::vector<Member> ensembleMembers(int count) {
+    std::vector<Member> members(count);
+    for (int k = 0; k < count; ++k) {
+        members[k].friction_coef *= 1.0f + 0.1f * k;
+        members[k].levelOffset = 0.05f * k;
+    }
+    return members;
+}
+
+#ifdef WATERSIM_BENCH_GPU
+// contexte sans surface : EGL_EXT_platform_device / surfaceless quand le pilote le permet, aucun display requis
+bool createHeadlessContext(Platform::WindowlessEglContext &eglContext, Platform::GLContext &glContext) {
+    eglContext = Platform::WindowlessEglContext{Platform::WindowlessEglContext::Configuration{}, &glContext};
+    if (!eglContext.isCreated() || !eglContext.makeCurrent() || !glContext.tryCreate()) {
+        Error{} << "Could not create a headless EGL context";
+        return false;
+    }
+    return true;
+}
+#endif
+
+bool runEnsembleCPU(const BenchOptions &options, unsigned threads, BenchResult &result) {
+    if (options.precision != "fp32") {
+        Error{} << "The CPU ensemble only supports fp32 storage";
+        return false;
+    }
+
+    ShallowWaterEnsembleCPU sim(options.nx, options.ny, options.dx, options.dt,
+                                ensembleMembers<ShallowWaterEnsembleCPU::Member>(options.members), threads);
+
+    if (!options.heightmap.empty()) {
+        Containers::Optional<Trade::ImageData2D> image = loadHeightmap(options.heightmap, {options.nx, options.ny}, 4);
+        if (!image)
+            return false;
+        sim.loadTerrainHeightMap(&*image, options.terrainScaling);
+    }
+
+    if (options.scenario == "bump")
+        sim.initBump();
+    else if (options.scenario == "dambreak")
+        sim.initTop();
+    else {
+        Error{} << "Scenario" << options.scenario.c_str() << "is not available on the CPU backend (bump, dambreak)";
+        return false;
+    }
+
+    if (!options.csv)
+        Debug{} << "CPU ensemble:" << sim.size() << "members," << sim.threadCount() << "threads," << sim.kernelName()
+                << "kernels";
+
+    auto volume = [&] {
+        double total = 0.0;
+        for (int k = 0; k < sim.size(); ++k)
+            total += sim.totalVolume(k);
+        return total;
+    };
+
+    sim.advance(options.warmup);
+    result.volumeBefore = volume();
+
+    const auto start = std::chrono::steady_clock::now();
+    sim.advance(options.steps);
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.solverBytes = sim.memoryUsage();
+    result.volumeAfter = volume();
+    return true;
+}
+
+bool runCPU(const BenchOptions &options, unsigned threads, int sweepSteps, int activeTileSize, BenchResult &result) {
+#ifdef WATERSIM_BENCH_GPU
+    // avant le solveur : ses pixel buffers doivent être détruits avec le contexte encore courant
+    Platform::WindowlessEglContext eglContext{NoCreate};
+    Platform::GLContext glContext{NoCreate};
+    GL::Texture2D heightTexture{NoCreate};
+    GL::Texture2D momentumTexture{NoCreate};
+    if (options.visualize) {
+        if (!createHeadlessContext(eglContext, glContext))
+            return false;
+        heightTexture = GL::Texture2D{};
+        heightTexture.setStorage(1, GL::TextureFormat::R8, {options.nx, options.ny});
+        momentumTexture = GL::Texture2D{};
+        momentumTexture.setStorage(1, GL::TextureFormat::RGB8, {options.nx, options.ny});
+    }
+#else
+    if (options.visualize) {
+        Error{} << "This build has no EGL support, --visualize is not available";
+        return false;
+    }
+#endif
+
+    ShallowWaterCPU sim(options.nx, options.ny, options.dx, options.dt, threads);
+    if (sweepSteps > 0)
+        sim.setTiling(sweepSteps);
+    if (options.precision == "fp16")
+        sim.setStoragePrecision(ShallowWaterCPU::StoragePrecision::Float16);
+    else if (options.precision == "bf16")
+        sim.setStoragePrecision(ShallowWaterCPU::StoragePrecision::BFloat16);
+    else if (options.precision != "fp32") {
+        Error{} << "Unknown precision" << options.precision.c_str() << "(fp32, fp16, bf16)";
+        return false;
+    }
+    if (activeTileSize > 0)
+        sim.setActiveTiles(true, activeTileSize);
+
+    if (!options.heightmap.empty()) {
+        // le solveur CPU lit le canal rouge d'une image RGBA de nx x ny
+        Containers::Optional<Trade::ImageData2D> image = loadHeightmap(options.heightmap, {options.nx, options.ny}, 4);
+        if (!image)
+            return false;
+        sim.loadTerrainHeightMap(&*image, options.terrainScaling);
+    }
+
+    if (options.scenario == "bump")
+        sim.initBump();
+    else if (options.scenario == "dambreak")
+        sim.initTop();
+    else {
+        Error{} << "Scenario" << options.scenario.c_str() << "is not available on the CPU backend (bump, dambreak)";
+        return false;
+    }
+
+    if (!options.csv)
+        Debug{} << "CPU backend:" << sim.threadCount() << "threads," << sim.kernelName() << "kernels";
+
+    // un pas puis les deux textures, comme une frame de l'application
+    auto advance = [&](int steps) {
+#ifdef WATERSIM_BENCH_GPU
+        if (options.visualize) {
+            for (int i = 0; i < steps; ++i) {
+                sim.step();
+                sim.updateHeightTexture(&heightTexture);
+                sim.updateMomentumTexture(&momentumTexture);
+            }
+            return;
+        }
+#endif
+        sim.advance(steps);
+    };
+
+    advance(options.warmup);
+    result.volumeBefore = sim.totalVolume();
+
+    const auto start = std::chrono::steady_clock::now();
+    advance(options.steps);
+#ifdef WATERSIM_BENCH_GPU
+    if (options.visualize)
+        GL::Renderer::finish(); // les envois depuis les pixel buffers sont asynchrones
+#endif
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.solverBytes = sim.memoryUsage();
+    result.volumeAfter = sim.totalVolume();
+    return true;
+}
+
+#ifdef WATERSIM_BENCH_GPU
+bool gpuPrecision(const BenchOptions &options, ShallowWater::StoragePrecision &precision) {
+    precision = ShallowWater::StoragePrecision::Float32;
+    if (options.precision == "fp16")
+        precision = ShallowWater::StoragePrecision::Float16;
+    else if (options.precision != "fp32") {
+        // pas de format d'image bf16 en GL
+        Error{} << "Precision" << options.precision.c_str() << "is not available on the GPU backend (fp32, fp16)";
+        return false;
+    }
+    return true;
+}
+
+bool runEnsembleGPU(const BenchOptions &options, BenchResult &result) {
+    ShallowWater::StoragePrecision precision;
+    if (!gpuPrecision(options, precision))
+        return false;
+
+    ShallowWaterEnsemble sim(options.nx, options.ny, options.dx, options.dt,
+                             ensembleMembers<ShallowWaterEnsemble::Member>(options.members), 16, precision);
+
+    if (!options.heightmap.empty()) {
+        Containers::Optional<Trade::ImageData2D> image =
+            loadHeightmap(options.heightmap, {options.nx + 1, options.ny + 1}, 1);
+        if (!image)
+            return false;
+        sim.loadTerrainHeightMap(&*image, options.terrainScaling, 1);
+    }
+
+    if (options.scenario == "bump")
+        sim.initBump();
+    else if (options.scenario == "dambreak")
+        sim.initDamBreak();
+    else if (options.scenario == "tsunami")
+        sim.initTsunami();
+    else {
+        Error{} << "Unknown scenario" << options.scenario.c_str() << "(bump, dambreak, tsunami)";
+        return false;
+    }
+
+    auto volume = [&] {
+        double total = 0.0;
+        for (double v : sim.totalVolumes())
+            total += v;
+        return total;
+    };
+
+    for (int i = 0; i < options.warmup; ++i)
+        sim.step();
+    result.volumeBefore = volume();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < options.steps; ++i)
+        sim.step();
+    GL::Renderer::finish();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.solverBytes = sim.memoryUsage();
+    result.volumeAfter = volume();
+    return true;
+}
+
+// monde en tuiles, sans ondes d'Airy : le bump est un disque d'eau au centre du monde
+bool runWorldGPU(const BenchOptions &options, bool fusedStep, BenchResult &result) {
+    ShallowWater::StoragePrecision precision;
+    if (!gpuPrecision(options, precision))
+        return false;
+    if (options.scenario != "bump") {
+        Error{} << "The tiled world only has the bump scenario";
+        return false;
+    }
+
+    WaterWorld world(options.worldTiles, options.worldTiles, std::size_t(options.nx), options.dx, options.dt,
+                     precision);
+    for (int y = 0; y != world.tilesY(); ++y)
+        for (int x = 0; x != world.tilesX(); ++x)
+            world.tile(x, y).fusedStepEnabled = fusedStep;
+
+    const Vector2i size = world.size();
+    if (!options.heightmap.empty()) {
+        Containers::Optional<Trade::ImageData2D> image = loadHeightmap(options.heightmap, size, 1);
+        if (!image)
+            return false;
+        world.loadTerrainHeightMap(&*image, options.terrainScaling, 1);
+    }
+
+    world.initEmpty();
+    world.createWater(size.x() * 0.5f, size.y() * 0.5f, size.x() * 0.125f, 2.0f);
+
+    for (int i = 0; i < options.warmup; ++i)
+        world.step();
+    result.volumeBefore = world.totalVolume();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < options.steps; ++i)
+        world.step();
+    GL::Renderer::finish();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.volumeAfter = world.totalVolume();
+    result.solverBytes = world.memoryUsage();
+    result.cells = double(size.x() - 1) * double(size.y() - 1);
+    if (!options.csv)
+        Debug{} << "Tiled world:" << size.x() - 1 << "x" << size.y() - 1 << "cells," << world.awakeTileCount()
+                << "awake tiles";
+    return true;
+}
+
+bool runGPU(const BenchOptions &options, bool airyWaves, bool fusedStep, BenchResult &result) {
+    Platform::WindowlessEglContext eglContext{NoCreate};
+    Platform::GLContext glContext{NoCreate};
+    if (!createHeadlessContext(eglContext, glContext))
+        return false;
+
+    if (!options.csv)
+        Debug{} << "GPU backend:" << GL::Context::current().rendererString() << "-"
+                << GL::Context::current().versionString();
+
+    // l'ensemble ne fait que le shallow water, sans ondes d'Airy
+    if (options.members > 1)
+        return runEnsembleGPU(options, result);
+    // les tuiles ne font que le shallow water
+    if (options.worldTiles > 1)
+        return runWorldGPU(options, fusedStep, result);
+
+    ShallowWater::StoragePrecision precision;
+    if (!gpuPrecision(options, precision))
+        return false;
+
+    ShallowWater sim(options.nx, options.ny, options.dx, options.dt, 16, precision);
+    sim.airyWavesEnabled = airyWaves;
+    sim.fusedStepEnabled = fusedStep;
+
+    if (!options.heightmap.empty()) {
+        // textures du solveur GPU : (nx + 1) x (ny + 1), un canal suffit
+        Containers::Optional<Trade::ImageData2D> image =
+            loadHeightmap(options.heightmap, {options.nx + 1, options.ny + 1}, 1);
+        if (!image)
+            return false;
+        sim.loadTerrainHeightMap(&*image, options.terrainScaling, 1);
+    }
+
+    if (options.scenario == "bump")
+        sim.initBump();
+    else if (options.scenario == "dambreak")
+        sim.initDamBreak();
+    else if (options.scenario == "tsunami")
+        sim.initTsunami();
+    else {
+        Error{} << "Unknown scenario" << options.scenario.c_str() << "(bump, dambreak, tsunami)";
+        return false;
+    }
+
+    for (int i = 0; i < options.warmup; ++i)
+        sim.step();
+    result.volumeBefore = sim.totalVolume();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < options.steps; ++i)
+        sim.step();
+    GL::Renderer::finish(); // les dispatchs sont asynchrones, on attend la fin réelle du calcul
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.volumeAfter = sim.totalVolume();
+    result.solverBytes = sim.memoryUsage();
+    return true;
+}
+#endif
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Utility::Arguments args;
+    args.addOption("backend", "cpu").setHelp("backend", "solver to run: cpu or gpu")
+        .addOption("scenario", "bump").setHelp("scenario", "initial state: bump, dambreak or tsunami (gpu only)")
+        .addOption("heightmap").setHelp("heightmap", "terrain image file, flat terrain if empty", "FILE")
+        .addOption("terrain-scaling", "20").setHelp("terrain-scaling", "terrain height for a white pixel")
+        .addOption("nx", "511").setHelp("nx", "cells along x (gpu: nx + 1 even, (nx + 1) / 2 and ny + 1 products of 2, 3 and 5 for the FFT)")
+        .addOption("ny", "511").setHelp("ny", "cells along y")
+        .addOption("dx", "0.25").setHelp("dx", "cell size")
+        .addOption("dt", "0.0166667").setHelp("dt", "timestep")
+        .addOption("steps", "200").setHelp("steps", "timed steps")
+        .addOption("warmup", "20").setHelp("warmup", "untimed steps run first")
+        .addOption("precision", "fp32").setHelp("precision", "state storage: fp32, fp16 or bf16 (cpu only)")
+        .addOption("members", "1").setHelp("members", "ensemble size, > 1 steps that many variants together")
+        .addOption("world-tiles", "1").setHelp("world-tiles", "gpu: > 1 runs a tiled world of that many tiles per side, each nx cells, bump only, no airy waves")
+        .addOption("threads", "0").setHelp("threads", "cpu: worker threads, 0 = one per core")
+        .addOption("sweep", "0").setHelp("sweep", "cpu: steps fused per tiled sweep, 0 = untiled")
+        .addOption("active-tiles", "0").setHelp("active-tiles", "cpu: active tile size, 0 = disabled")
+        .addBooleanOption("visualize").setHelp("visualize", "cpu: also fill the height and velocity textures every step (needs EGL)")
+        .addBooleanOption("no-airy").setHelp("no-airy", "gpu: plain shallow water, no airy wave decomposition")
+        .addBooleanOption("unfused").setHelp("unfused", "gpu, with --no-airy: separate flux and height dispatches")
+        .addBooleanOption("csv").setHelp("csv", "print a single CSV line instead of a report")
+        .addBooleanOption("csv-header").setHelp("csv-header", "with --csv, print the column names line first")
+        .setGlobalHelp("Headless throughput benchmark for the water solvers.")
+        .parse(argc, argv);
+
+    BenchOptions options;
+    options.backend = args.value("backend");
+    options.scenario = args.value("scenario");
+    options.heightmap = args.value("heightmap");
+    options.precision = args.value("precision");
+    options.terrainScaling = args.value<float>("terrain-scaling");
+    options.nx = args.value<int>("nx");
+    options.ny = args.value<int>("ny");
+    options.dx = args.value<float>("dx");
+    options.dt = args.value<float>("dt");
+    options.steps = args.value<int>("steps");
+    options.warmup = args.value<int>("warmup");
+    options.members = args.value<int>("members");
+    options.worldTiles = args.value<int>("world-tiles");
+    options.visualize = args.isSet("visualize");
+    options.csv = args.isSet("csv");
+
+    if (options.nx <= 0 || options.ny <= 0 || options.steps <= 0 || options.warmup < 0 || options.members <= 0) {
+        Error{} << "nx, ny, steps and members must be positive";
+        return 1;
+    }
+
+    BenchResult result;
+    bool ok = false;
+    if (options.backend == "cpu" && options.members > 1) {
+        ok = runEnsembleCPU(options, args.value<unsigned>("threads"), result);
+    } else if (options.backend == "cpu") {
+        ok = runCPU(options, args.value<unsigned>("threads"), args.value<int>("sweep"), args.value<int>("active-tiles"),
+                    result);
+    } else if (options.backend == "gpu") {
+#ifdef WATERSIM_BENCH_GPU
+        ok = runGPU(options, !args.isSet("no-airy"), !args.isSet("unfused"), result);
+#else
+        Error{} << "This build has no EGL support, only the cpu backend is available";
+#endif
+    } else {
+        Error{} << "Unknown backend" << options.backend.c_str() << "(cpu, gpu)";
+    }
+    if (!ok)
+        return 1;
+
+    const double cells =
+        result.cells != 0.0 ? result.cells : double(options.nx) * double(options.ny) * options.members;
+    const double msPerStep = result.seconds * 1000.0 / options.steps;
+    const double cellsPerSecond = cells * options.steps / result.seconds;
+    const double solverMiB = double(result.solverBytes) / (1024.0 * 1024.0);
+    const double peakMiB = double(peakResidentBytes()) / (1024.0 * 1024.0);
+    // dérive relative du volume pendant les pas chronométrés (sans source ni bord ouvert, elle devrait rester nulle)
+    const double massDrift =
+        result.volumeBefore != 0.0 ? (result.volumeAfter - result.volumeBefore) / result.volumeBefore : 0.0;
+
+    if (options.csv) {
+        if (args.isSet("csv-header"))
+            std::printf("backend,scenario,precision,members,nx,ny,steps,ms_per_step,cells_per_s,solver_mib,"
+                        "peak_rss_mib,mass_drift\n");
+        std::printf("%s,%s,%s,%d,%d,%d,%d,%.4f,%.4g,%.2f,%.2f,%.3e\n", options.backend.c_str(),
+                    options.scenario.c_str(), options.precision.c_str(), options.members, options.nx, options.ny,
+                    options.steps, msPerStep, cellsPerSecond, solverMiB, peakMiB, massDrift);
+    } else {
+        std::printf("%s %s %s %dx%d, %d steps in %.3f s\n", options.backend.c_str(), options.scenario.c_str(),
+                    options.precision.c_str(), options.nx, options.ny, options.steps, result.seconds);
+        if (options.members > 1)
+            std::printf("  %d members\n", options.members);
+        std::printf("  %.4f ms/step, %.4g cells/s\n", msPerStep, cellsPerSecond);
+        if (result.solverBytes)
+            std::printf("  solver memory %.2f MiB\n", solverMiB);
+        std::printf("  peak RSS %.2f MiB\n", peakMiB);
+        std::printf("  mass drift %.3e\n", massDrift);
+    }
+    return 0;
+}
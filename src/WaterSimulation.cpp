@@ -9,6 +9,7 @@
 #include <WaterSimulation/Mesh.h>
 #include <WaterSimulation/UIManager.h>
 #include <WaterSimulation/ECS.h>
+#include <WaterSimulation/ProgramCache.h>
 
 #include <WaterSimulation/Rendering/CustomShader/TerrainShader.h>
 #include <WaterSimulation/Rendering/CustomShader/DebugShader.h>
@@ -27,6 +28,8 @@
 #include <WaterSimulation/Components/RigidBodyComponent.h>
 
 #include <Corrade/Containers/StringView.h>
+#include <Corrade/Containers/StringStl.h>
+#include <Corrade/Containers/Optional.h>
 #include <Corrade/PluginManager/Manager.h>
 #include <Corrade/Utility/ConfigurationGroup.h>
 #include <Corrade/Utility/Debug.h>
@@ -161,7 +164,11 @@ WaterSimulation::Application::Application(const Arguments& arguments):
     Debug{} << "SIZE IS : " << resized->size(); */
     
     // Shallow Water simulation setup
+    // binaires des programmes de calcul : au redémarrage, seuls les shaders modifiés sont recompilés
+    if (const auto configuration = Corrade::Utility::Path::configurationDirectory("WaterSimulation"))
+        ProgramCache::setDirectory(Corrade::Utility::Path::join(*configuration, "programs"));
     m_shallowWaterSimulation = ShallowWater(511,511, .25f, 1.0f/60.0f);
+    m_shallowWaterSimulation.setProfiler(&m_gpuProfiler);
     m_heightmapReadback.init({m_shallowWaterSimulation.getnx() + 1, m_shallowWaterSimulation.getny() + 1});
 
     
@@ -268,6 +275,7 @@ WaterSimulation::Application::Application(const Arguments& arguments):
     m_registry.emplace<ShadowCasterComponent>(sunEntity);  
 
     m_renderSystem.setHeightmapReadback(&m_heightmapReadback);
+    m_renderSystem.setProfiler(&m_gpuProfiler);
     m_physicSystem.setHeightmapReadback(&m_heightmapReadback);
 }
     
@@ -288,6 +296,8 @@ void WaterSimulation::Application::viewportEvent(ViewportEvent& event) {
 
 //main draw loop
 void WaterSimulation::Application::drawEvent() {
+    m_gpuProfiler.beginFrame();
+
     GL::Renderer::enable(GL::Renderer::Feature::DepthTest);
     GL::defaultFramebuffer.clear(GL::FramebufferClear::Color | GL::FramebufferClear::Depth);
     
@@ -302,30 +312,36 @@ void WaterSimulation::Application::drawEvent() {
     
 
     if(!simulationPaused) {
-        for(int i = 0; i < step_number; ++i){
+        // les systèmes CPU des step_number sous-pas d'abord : ils lisent tous la même copie CPU de la hauteur (relue
+        // avec une frame de retard), leurs perturbations partent en un seul envoi. Les pas du solveur sont ensuite
+        // soumis d'un bloc et l'état n'est relu qu'une fois. Avec le pas adaptatif, un seul passage : la simulation
+        // découpe elle-même le temps en sous-pas stables
+        const int cpuSubsteps = m_shallowWaterSimulation.adaptiveTimestep ? 1 : step_number;
+        m_wakeDisturbances.clear();
+        for(int i = 0; i < cpuSubsteps; ++i){
             m_transform_System.update(m_registry);
             m_physicSystem.update(m_registry, m_deltaTime);
 
             // appliquer les mouvments sur l'eau 
-            const auto& disturbances = m_physicSystem.getDisturbances();
-            if (!disturbances.empty()) {
-                std::vector<ShallowWater::Disturbance> wakeDisturbances;
-                wakeDisturbances.reserve(disturbances.size());
-                for (const auto& d : disturbances) {
-                    wakeDisturbances.push_back({d.px, d.py, d.strength, d._padding});
-                }
-                m_shallowWaterSimulation.applyDisturbances(wakeDisturbances);
-            }
-
-            m_shallowWaterSimulation.step();
-            m_heightmapReadback.enqueueReadback(m_shallowWaterSimulation.getStateTexture());
+            for (const auto& d : m_physicSystem.getDisturbances())
+                m_wakeDisturbances.push_back({d.px, d.py, d.strength, d._padding});
         }
+        m_shallowWaterSimulation.applyDisturbances(m_wakeDisturbances);
+
+        m_shallowWaterSimulation.advanceTime(step_number * m_shallowWaterSimulation.getMaxDt());
+        m_heightmapReadback.enqueueReadback(m_shallowWaterSimulation.getStateTexture());
+    } else {
+        // eau ajoutée depuis l'interface, visible sans relancer la simulation
+        m_shallowWaterSimulation.flushSources(0.0f);
     }
 
 
     m_renderSystem.render(m_registry, *m_camera.get());
 
-    m_UIManager->drawUI(*this);
+    {
+        GpuProfiler::Scope profile{&m_gpuProfiler, "ui"};
+        m_UIManager->drawUI(*this);
+    }
 
     if(m_cursorLocked)
         setCursor(Platform::Sdl2Application::Cursor::HiddenLocked);
@@ -475,9 +491,8 @@ uint32_t WaterSimulation::Application::createSphereEntity(const Magnum::Vector3&
         m_registry.emplace<MeshComponent>(e, std::vector<std::pair<float, Mesh*>>{});
     }
 
-    if (m_pbrShader) {
-        m_registry.emplace<ShaderComponent>(e, m_pbrShader);
-    }
+    // un seul PBRShader pour toutes les sphères, créé avec l'application
+    m_registry.emplace<ShaderComponent>(e, m_pbrShader);
 
     auto& rb = m_registry.emplace<RigidBodyComponent>(e);
     rb.mass = mass;
@@ -495,12 +510,6 @@ uint32_t WaterSimulation::Application::createSphereEntity(const Magnum::Vector3&
     b.flotability = flotability;
     b.waterDrag = waterDrag;
 
-    auto shaderPtr = std::make_shared<PBRShader>();
-    m_registry.emplace<ShaderComponent>(
-        e,
-        shaderPtr
-    ); 
-
     return e;
 }
 
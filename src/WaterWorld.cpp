@@ -0,0 +1,283 @@
+#include <WaterSimulation/WaterWorld.h>
+
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/StridedArrayView.h>
+#include <Corrade/Utility/DebugAssert.h>
+#include <Magnum/GL/GL.h>
+#include <Magnum/GL/Renderer.h>
+#include <Magnum/GL/Texture.h>
+#include <Magnum/Image.h>
+#include <Magnum/Math/Functions.h>
+#include <Magnum/Math/Range.h>
+#include <Magnum/PixelFormat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+WaterWorld::WaterWorld(int tilesX, int tilesY, std::size_t tileCells, float dx, float dt,
+                       ShallowWater::StoragePrecision precision)
+    : m_tilesX{tilesX}, m_tilesY{tilesY}, m_tileTexels{int(tileCells) + 1}, m_dx{dx}, m_maxDt{dt},
+      m_interestRadius{std::numeric_limits<float>::infinity()} {
+    CORRADE_INTERNAL_ASSERT(tilesX > 0 && tilesY > 0 && m_tileTexels > 4 * HaloWidth);
+
+    // réservé : ShallowWater n'est pas fait pour être déplacé en cours de route
+    m_tiles.reserve(std::size_t(tilesX * tilesY));
+    for (int i = 0; i < tilesX * tilesY; ++i) {
+        m_tiles.emplace_back(tileCells, tileCells, dx, dt, 16, precision);
+        m_tiles.back().airyWavesEnabled = false;
+    }
+    m_awake.assign(m_tiles.size(), true);
+    m_wet.assign(m_tiles.size(), true);
+}
+
+Magnum::Vector2i WaterWorld::size() const {
+    const int stride = m_tileTexels - 2 * HaloWidth;
+    return {m_tilesX * stride + 2 * HaloWidth, m_tilesY * stride + 2 * HaloWidth};
+}
+
+Magnum::Vector2i WaterWorld::tileOrigin(int x, int y) const {
+    return Magnum::Vector2i{x, y} * (m_tileTexels - 2 * HaloWidth);
+}
+
+std::pair<Magnum::Vector2i, Magnum::Vector2i> WaterWorld::ownedRange(int x, int y) const {
+    // les bords du monde appartiennent aux tuiles de bord, halo compris
+    const Magnum::Vector2i origin = tileOrigin(x, y);
+    const Magnum::Vector2i min = origin + Magnum::Vector2i{x == 0 ? 0 : HaloWidth, y == 0 ? 0 : HaloWidth};
+    const Magnum::Vector2i max = origin + Magnum::Vector2i{x == m_tilesX - 1 ? m_tileTexels : m_tileTexels - HaloWidth,
+                                                           y == m_tilesY - 1 ? m_tileTexels : m_tileTexels - HaloWidth};
+    return {min, max};
+}
+
+Magnum::Vector2i WaterWorld::owner(float x, float y) const {
+    const int stride = m_tileTexels - 2 * HaloWidth;
+    return {Magnum::Math::clamp(int(std::floor((x - HaloWidth) / stride)), 0, m_tilesX - 1),
+            Magnum::Math::clamp(int(std::floor((y - HaloWidth) / stride)), 0, m_tilesY - 1)};
+}
+
+int WaterWorld::awakeTileCount() const {
+    return int(std::count(m_awake.begin(), m_awake.end(), true));
+}
+
+void WaterWorld::loadTerrainHeightMap(Magnum::Trade::ImageData2D *image, float scaling, int channels) {
+    CORRADE_INTERNAL_ASSERT(image->size() == size());
+
+    // lignes de chaque tuile recopiées sans alignement, comme les lit ShallowWater::loadTerrainHeightMap
+    const Corrade::Containers::StridedArrayView3D<const char> pixels = image->pixels();
+    const std::size_t pixelSize = pixels.size()[2];
+    for (int ty = 0; ty < m_tilesY; ++ty) {
+        for (int tx = 0; tx < m_tilesX; ++tx) {
+            const Magnum::Vector2i origin = tileOrigin(tx, ty);
+            Corrade::Containers::Array<char> data{std::size_t(m_tileTexels) * std::size_t(m_tileTexels) * pixelSize};
+            for (int j = 0; j < m_tileTexels; ++j)
+                for (int i = 0; i < m_tileTexels; ++i)
+                    std::memcpy(data.data() + (std::size_t(j) * m_tileTexels + i) * pixelSize,
+                                &pixels[std::size_t(origin.y() + j)][std::size_t(origin.x() + i)][0], pixelSize);
+
+            Magnum::Trade::ImageData2D tileImage{Magnum::PixelStorage{}.setAlignment(1), image->format(),
+                                                 {m_tileTexels, m_tileTexels}, std::move(data)};
+            tile(tx, ty).loadTerrainHeightMap(&tileImage, scaling, channels);
+        }
+    }
+}
+
+void WaterWorld::initEmpty() {
+    for (ShallowWater &shallowWater : m_tiles)
+        shallowWater.initEmpty();
+    m_wet.assign(m_tiles.size(), false);
+    updateAwake();
+}
+
+void WaterWorld::createWater(float x, float y, float radius, float quantity) {
+    for (int ty = 0; ty < m_tilesY; ++ty) {
+        for (int tx = 0; tx < m_tilesX; ++tx) {
+            // disque et texels de la tuile, halo compris : le recouvrement reçoit la même eau des deux côtés
+            const Magnum::Vector2i origin = tileOrigin(tx, ty);
+            if (x + radius < origin.x() || x - radius > origin.x() + m_tileTexels || y + radius < origin.y() ||
+                y - radius > origin.y() + m_tileTexels)
+                continue;
+            tile(tx, ty).createWater(x - origin.x(), y - origin.y(), radius, quantity);
+            m_wet[index(tx, ty)] = true;
+        }
+    }
+    updateAwake();
+}
+
+int WaterWorld::addInflow(float x, float y, float radius, std::vector<Magnum::Vector2> hydrograph) {
+    const Magnum::Vector2i t = owner(x, y);
+    const Magnum::Vector2i origin = tileOrigin(t.x(), t.y());
+    const int id = tile(t.x(), t.y()).addInflow(x - origin.x(), y - origin.y(), radius, std::move(hydrograph));
+    m_sources.emplace_back(index(t.x(), t.y()), id);
+    m_wet[index(t.x(), t.y())] = true;
+    updateAwake();
+    return int(m_sources.size()) - 1;
+}
+
+int WaterWorld::addDrain(float x, float y, float radius, float rate) {
+    const Magnum::Vector2i t = owner(x, y);
+    const Magnum::Vector2i origin = tileOrigin(t.x(), t.y());
+    const int id = tile(t.x(), t.y()).addDrain(x - origin.x(), y - origin.y(), radius, rate);
+    m_sources.emplace_back(index(t.x(), t.y()), id);
+    return int(m_sources.size()) - 1;
+}
+
+void WaterWorld::removeSource(int id) {
+    std::pair<std::size_t, int> &source = m_sources[std::size_t(id)];
+    if (source.second < 0)
+        return;
+    m_tiles[source.first].removeSource(source.second);
+    source.second = -1;
+}
+
+void WaterWorld::setInterest(const Magnum::Vector2 &center, float radius) {
+    m_interestCenter = center;
+    m_interestRadius = radius;
+    updateAwake();
+}
+
+int WaterWorld::advanceTime(float simulatedTime) {
+    if (simulatedTime <= 0.0f)
+        return 0;
+
+    float dt = m_maxDt;
+    int substeps = static_cast<int>(std::lround(simulatedTime / dt));
+
+    if (adaptiveTimestep) {
+        // le plus petit pas stable des tuiles éveillées, les tuiles endormies ne bougent pas
+        float stable = m_maxDt;
+        for (std::size_t t = 0; t < m_tiles.size(); ++t) {
+            if (!m_awake[t])
+                continue;
+            m_tiles[t].cflNumber = cflNumber;
+            stable = std::min(stable, m_tiles[t].enforceCFL());
+        }
+        substeps = static_cast<int>(std::ceil(simulatedTime / stable));
+        dt = simulatedTime / substeps;
+        if (substeps > maxSubsteps) {
+            substeps = maxSubsteps;
+            dt = stable;
+        }
+    }
+
+    for (ShallowWater &shallowWater : m_tiles)
+        if (shallowWater.getdt() != dt)
+            shallowWater.setTimestep(dt);
+    for (int i = 0; i < substeps; ++i)
+        step();
+
+    if (adaptiveTimestep)
+        for (std::size_t t = 0; t < m_tiles.size(); ++t)
+            if (m_awake[t])
+                m_tiles[t].dispatchMaxWaveSpeed();
+    return substeps;
+}
+
+void WaterWorld::step() {
+    for (std::size_t t = 0; t < m_tiles.size(); ++t)
+        if (m_awake[t])
+            m_tiles[t].step();
+    exchangeHalos(false);
+
+    if (++m_stepsSinceCheck >= sleepCheckSteps)
+        updateSleep();
+}
+
+void WaterWorld::updateSleep() {
+    m_stepsSinceCheck = 0;
+    for (std::size_t t = 0; t < m_tiles.size(); ++t)
+        if (m_awake[t])
+            m_wet[t] = m_tiles[t].lastActiveTileCount() != 0; // -1 : pas sur toute la grille, on ne sait pas
+    // une source peut démarrer plus tard (hydrogramme), sa tuile reste mouillée
+    for (const std::pair<std::size_t, int> &source : m_sources)
+        if (source.second >= 0)
+            m_wet[source.first] = true;
+    updateAwake();
+}
+
+void WaterWorld::updateAwake() {
+    bool woke = false;
+    for (int ty = 0; ty < m_tilesY; ++ty) {
+        for (int tx = 0; tx < m_tilesX; ++tx) {
+            // distance de l'intérêt aux cellules possédées
+            const std::pair<Magnum::Vector2i, Magnum::Vector2i> range = ownedRange(tx, ty);
+            const Magnum::Vector2 nearest =
+                Magnum::Math::clamp(m_interestCenter, Magnum::Vector2{range.first}, Magnum::Vector2{range.second});
+            const bool near = (nearest - m_interestCenter).length() <= m_interestRadius;
+
+            bool wet = false;
+            for (int ny = std::max(ty - 1, 0); ny <= std::min(ty + 1, m_tilesY - 1); ++ny)
+                for (int nx = std::max(tx - 1, 0); nx <= std::min(tx + 1, m_tilesX - 1); ++nx)
+                    wet = wet || m_wet[index(nx, ny)];
+
+            const bool awake = near && wet;
+            woke = woke || (awake && !m_awake[index(tx, ty)]);
+            m_awake[index(tx, ty)] = awake;
+        }
+    }
+
+    // les halos d'une tuile qui se réveille ont pu manquer des échanges entre tuiles endormies
+    if (woke)
+        exchangeHalos(true);
+}
+
+void WaterWorld::exchangeHalos(bool all) {
+    // les copies lisent ce que les pas viennent d'écrire par imageStore
+    Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::TextureUpdate);
+
+    const int T = m_tileTexels;
+    const int H = HaloWidth;
+    auto copy = [](ShallowWater &from, const Magnum::Vector2i &fromPos, ShallowWater &to,
+                   const Magnum::Vector2i &toPos, const Magnum::Vector2i &extent) {
+        glCopyImageSubData(from.getStateTexture().id(), GL_TEXTURE_2D, 0, fromPos.x(), fromPos.y(), 0,
+                           to.getStateTexture().id(), GL_TEXTURE_2D, 0, toPos.x(), toPos.y(), 0, extent.x(),
+                           extent.y(), 1);
+    };
+
+    // colonnes d'abord, puis lignes sur toute la largeur : les coins passent par la voisine de côté
+    for (int ty = 0; ty < m_tilesY; ++ty) {
+        for (int tx = 0; tx + 1 < m_tilesX; ++tx) {
+            if (!all && !m_awake[index(tx, ty)] && !m_awake[index(tx + 1, ty)])
+                continue;
+            ShallowWater &left = tile(tx, ty);
+            ShallowWater &right = tile(tx + 1, ty);
+            copy(left, {T - 2 * H, 0}, right, {0, 0}, {H, T});
+            copy(right, {H, 0}, left, {T - H, 0}, {H, T});
+        }
+    }
+    for (int ty = 0; ty + 1 < m_tilesY; ++ty) {
+        for (int tx = 0; tx < m_tilesX; ++tx) {
+            if (!all && !m_awake[index(tx, ty)] && !m_awake[index(tx, ty + 1)])
+                continue;
+            ShallowWater &bottom = tile(tx, ty);
+            ShallowWater &top = tile(tx, ty + 1);
+            copy(bottom, {0, T - 2 * H}, top, {0, 0}, {T, H});
+            copy(top, {0, H}, bottom, {0, T - H}, {T, H});
+        }
+    }
+}
+
+std::size_t WaterWorld::memoryUsage() {
+    std::size_t bytes = 0;
+    for (ShallowWater &shallowWater : m_tiles)
+        bytes += shallowWater.memoryUsage();
+    return bytes;
+}
+
+double WaterWorld::totalVolume() {
+    Magnum::GL::Renderer::setMemoryBarrier(Magnum::GL::Renderer::MemoryBarrier::TextureUpdate);
+
+    double volume = 0.0;
+    for (int ty = 0; ty < m_tilesY; ++ty) {
+        for (int tx = 0; tx < m_tilesX; ++tx) {
+            const Magnum::Vector2i origin = tileOrigin(tx, ty);
+            const std::pair<Magnum::Vector2i, Magnum::Vector2i> range = ownedRange(tx, ty);
+            Magnum::Image2D h = tile(tx, ty).getStateTexture().subImage(
+                0, Magnum::Range2Di{range.first - origin, range.second - origin}, {Magnum::PixelFormat::R32F});
+            for (const Corrade::Containers::StridedArrayView1D<const float> row : h.pixels<float>())
+                for (float value : row)
+                    volume += value;
+        }
+    }
+    return volume * m_dx * m_dx;
+}